@@ -61,6 +61,15 @@ namespace CrossSock {
 		CLIENT_CONNECTED = 6
 	};
 
+	/* A finalized packet waiting in the client's outbound stream stage */
+	struct CrossStagedPack
+	{
+		CrossPackDataID dataID;
+		size_t offset;
+		CrossPackPayloadLen length;
+		bool isReplaceable;
+	};
+
 	/* Client properties list */
 	struct CrossClientProperties {
 
@@ -107,6 +116,60 @@ namespace CrossSock {
 		 */
 		double alivenessTestDelay;
 
+		/*
+		 * The socket options applied to the server and stream sockets (see
+		 * CrossSockProfile::LowLatency and CrossSockProfile::BulkThroughput)
+		 */
+		CrossSockProfile socketProfile;
+
+		/*
+		 * The maximum datagram size (in bytes) that unreliable packets are aggregated
+		 * into - packets are collected during the frame and sent together at the end
+		 * of the update (or on FlushStreams). 1472 fills a 1500 byte ethernet MTU, and
+		 * 0 disables aggregation.
+		 */
+		int streamAggregateSize;
+
+		/*
+		 * If reliable packets should be collected during the frame and written with
+		 * a single send at the end of the update (or on FlushSends) - bytes a full
+		 * socket won't take are kept for the next update
+		 */
+		bool shouldBatchSends;
+
+		/*
+		 * If the kernel receive time (SO_TIMESTAMPING, linux only) of every packet
+		 * should be recorded - see CrossPack::GetReceiveTime. Separates the time a
+		 * packet waited in this process from its time on the network.
+		 */
+		bool useReceiveTimestamps;
+
+		/*
+		 * The largest message (in bytes) the server may send to message handlers -
+		 * messages too large for a single packet are sent in fragments and
+		 * reassembled before they are handled
+		 */
+		int maxMessageSize;
+
+		/*
+		 * The memory (in bytes) this client may hold in unfinished messages -
+		 * fragments of messages that don't fit are dropped
+		 */
+		int maxReassemblyBytes;
+
+		/*
+		 * How long (in ms) an unfinished message is kept without receiving a
+		 * fragment - lost UDP fragments leave their message unfinished
+		 */
+		double fragmentTimeout;
+
+		/*
+		 * The number of fragment bytes sent per update step - the rest wait for
+		 * later updates, so that a large message doesn't hold back the packets
+		 * sent after it
+		 */
+		int fragmentBytesPerUpdate;
+
 		CrossClientProperties()
 		{
 			allowUDPPackets = true;
@@ -117,6 +180,13 @@ namespace CrossSock {
 			maxReconnectionAttempts = 100;
 			connectionDelay = 200.0;
 			alivenessTestDelay = 1000.0;
+			streamAggregateSize = 0;
+			shouldBatchSends = false;
+			useReceiveTimestamps = false;
+			maxMessageSize = 4194304;
+			maxReassemblyBytes = 8388608;
+			fragmentTimeout = 5000.0;
+			fragmentBytesPerUpdate = 131072;
 		}
 	};
 
@@ -129,8 +199,13 @@ namespace CrossSock {
 			serverSocket = nullptr;
 			streamSocket = nullptr;
 			clientID = 0;
+			checksumType = CrossChecksumType::CHECKSUM_SUM;
 			streamIsBound = false;
+			AllocateDatagramSlots();
+			tcpBuffer.reset(new CrossRingBuffer());
 			clientState = CrossClientState::CLIENT_NEEDS_TO_CONNECT;
+			streamAggregate.SetDataID(StaticDataID::AGGREGATE_PACK);
+			receiveTime = 0;
 			connectEvent = nullptr;
 			readyEvent = nullptr;
 			disconnectEvent = nullptr;
@@ -160,6 +235,9 @@ namespace CrossSock {
 			for (auto it = dataEvents.begin(); it != dataEvents.end(); ++it) {
 				delete *it;
 			}
+			for (auto it = messageEvents.begin(); it != messageEvents.end(); ++it) {
+				delete *it;
+			}
 			delete connectEvent;
 			delete readyEvent;
 			delete disconnectEvent;
@@ -177,8 +255,8 @@ namespace CrossSock {
 			serverAddress = inAddress;
 			addressFamily = inFamily;
 			connectionAttempts = 0;
-			tcpBufferLength = 0;
-			udpBufferLength = 0;
+			if (tcpBuffer)
+				tcpBuffer->Clear();
 			ping = 0;
 			clientState = CrossClientState::CLIENT_CONNECTING;
 			Update();
@@ -218,6 +296,11 @@ namespace CrossSock {
 					serverSocket->Close();
 					serverSocket.reset();
 				}
+				sendBatch.clear();
+				streamStage.clear();
+				stagedPacks.clear();
+				fragmenter.Clear(messageBufferPool);
+				reassembler.Clear(messageBufferPool);
 				if (streamSocket) {
 					streamSocket->Close();
 					streamSocket.reset();
@@ -231,8 +314,8 @@ namespace CrossSock {
 					connectionAttempts = 0;
 
 					/* reset buffers */
-					tcpBufferLength = 0;
-					udpBufferLength = 0;
+					if (tcpBuffer)
+						tcpBuffer->Clear();
 
 					/* attempt to reconnect */
 					clientState = CrossClientState::CLIENT_RECONNECTING;
@@ -266,6 +349,9 @@ namespace CrossSock {
 						serverSocket = CrossSockUtil::CreateTCPSocket(addressFamily);
 						if (serverSocket) {
 							serverSocket->SetNonBlockingMode(true);
+							serverSocket->ApplyProfile(clientProperties.socketProfile);
+							if (clientProperties.useReceiveTimestamps)
+								serverSocket->SetReceiveTimestampMode(true);
 						}
 						else {
 							err = CrossSockError::INVALID;
@@ -320,24 +406,29 @@ namespace CrossSock {
 					}
 				}
 
+				/* send the next fragments of large messages, and drop unfinished messages that went quiet */
+				if (fragmenter.GetNumMessages() > 0 && clientState == CrossClientState::CLIENT_CONNECTED)
+					FlushFragments();
+				if (reassembler.GetNumMessages() > 0)
+					reassembler.DropStaleMessages(messageClock.GetElapsedTime() - clientProperties.fragmentTimeout, messageBufferPool);
+
 				/* handle TCP data */
 				CrossBufferLen bytesReceived;
 				int tcpTransmits = 0;
 				do {
 					tcpTransmits++;
-					bytesReceived = serverSocket->Receive(tcpBuffer + tcpBufferLength, CROSS_SOCK_BUFFER_SIZE - tcpBufferLength);
+					CrossRingBuffer* buffer = tcpBuffer.get();
+					CrossPackData* writePtr = buffer->GetWritePtr();
+					bytesReceived = serverSocket->Receive(writePtr, (int)buffer->GetWriteSpace(), receiveTime);
 					if (bytesReceived > 0) {
-						tcpBufferLength += bytesReceived;
+						buffer->Commit(bytesReceived);
+
+						/* parse packets in place - unparsed bytes stay where they are */
 						CrossBufferLen dataUsed;
-						CrossBufferLen bufferPos = 0;
 						do {
-							dataUsed = OnReceiveNewData(tcpBuffer + bufferPos, tcpBufferLength - bufferPos, NetTransMethod::TCP);
-							bufferPos += dataUsed;
-						} while (IsRunning() && dataUsed > 0 && bufferPos < tcpBufferLength);
-
-						/* reset buffer to front */
-						tcpBufferLength -= bufferPos;
-						memcpy(tcpBuffer, tcpBuffer + bufferPos, tcpBufferLength);
+							dataUsed = OnReceiveNewData(buffer->GetReadPtr(), (CrossBufferLen)buffer->GetSize(), NetTransMethod::TCP);
+							buffer->Consume(dataUsed);
+						} while (IsRunning() && dataUsed > 0 && buffer->GetSize() > 0);
 					}
 					else if (CrossSockUtil::GetLastError() == CrossSockError::CONNRESET) {
 						Disconnect(true);
@@ -348,40 +439,42 @@ namespace CrossSock {
 				if (clientProperties.allowUDPPackets && clientState == CrossClientState::CLIENT_CONNECTED) {
 					if (streamIsBound) {
 						int udpTransmits = 0;
+						int batchSize;
+						int datagramsReceived;
 						do {
 							if (IsDisconnected())
 								break;
-							udpTransmits++;
-							CrossSockAddress fromAddress;
-							bytesReceived = streamSocket->ReceiveFrom(udpBuffer + udpBufferLength, CROSS_SOCK_BUFFER_SIZE - udpBufferLength, fromAddress);
-							if (bytesReceived > 0 && fromAddress == serverAddress) {
-								udpBufferLength += bytesReceived;
-								CrossBufferLen dataUsed;
-								CrossBufferLen bufferPos = 0;
-								do {
-									dataUsed = OnReceiveNewData(udpBuffer + bufferPos, udpBufferLength - bufferPos, NetTransMethod::UDP);
-									bufferPos += dataUsed;
-								} while (IsRunning() && streamIsBound && dataUsed > 0 && bufferPos < udpBufferLength);
-
-								/* reset buffer to front */
-								udpBufferLength -= bufferPos;
-								memcpy(udpBuffer, udpBuffer + bufferPos, udpBufferLength);
+
+							/* receive a batch of datagrams - each is parsed on its own */
+							batchSize = clientProperties.maxUDPTransmitsPerUpdate - udpTransmits;
+							if (batchSize > (int)udpDatagrams.size())
+								batchSize = (int)udpDatagrams.size();
+							datagramsReceived = streamSocket->ReceiveMany(udpDatagrams.data(), batchSize);
+							if (datagramsReceived > 0) {
+								udpTransmits += datagramsReceived;
+								for (int d = 0; d < datagramsReceived && IsRunning() && streamIsBound; d++) {
+									if (udpDatagrams[d].address == serverAddress)
+										OnReceiveDatagram(udpDatagrams[d]);
+								}
 							}
 							else if (CrossSockUtil::GetLastError() == CrossSockError::CONNRESET) {
 								streamIsBound = false;
-								udpBufferLength = 0;
 								if (streamSocket) {
 									streamSocket->Close();
 									streamSocket.reset();
 								}
 							}
-						} while (IsRunning() && streamIsBound && bytesReceived > 0 && udpTransmits < clientProperties.maxUDPTransmitsPerUpdate);
+						} while (IsRunning() && streamIsBound && datagramsReceived == batchSize && udpTransmits < clientProperties.maxUDPTransmitsPerUpdate);
 					}
 					else { /* bind UDP socket if needed */
 						if (!streamSocket) {
 							streamSocket = CrossSockUtil::CreateUDPSocket(addressFamily);
-							if (streamSocket)
+							if (streamSocket) {
 								streamSocket->SetNonBlockingMode(true);
+								streamSocket->ApplyProfile(clientProperties.socketProfile);
+								if (clientProperties.useReceiveTimestamps)
+									streamSocket->SetReceiveTimestampMode(true);
+							}
 						}
 						if (streamSocket) {
 							int result = streamSocket->Bind(GetLocalAddress());
@@ -391,6 +484,10 @@ namespace CrossSock {
 						}
 					}
 				}
+
+				/* send the packets collected during this frame - without blocking, so a full socket can't stall the update */
+				FlushSends(false);
+				FlushStreams();
 			}
 		}
 
@@ -462,6 +559,12 @@ namespace CrossSock {
 				return 0;
 		}
 
+		/* Returns the checksum algorithm agreed with the server during the handshake - packets streamed to the server are switched to it */
+		CrossChecksumType GetChecksumType() const
+		{
+			return checksumType;
+		}
+
 		/* Send a packet reliably to the server - returns the number of bytes sent if succesful, or the NetTransError if unsuccesful */
 		int SendToServer(const CrossPackPtr inPack, const bool inShouldBlockUntilSent = true) const
 		{
@@ -475,6 +578,15 @@ namespace CrossSock {
 				return NetTransError::CLIENT_NOT_CONNECTED;
 			}
 			else {
+				/* batch custom data until the end of the update - connection packets go out immediately, after the batch */
+				if (clientProperties.shouldBatchSends && inPack->GetDataID() >= StaticDataID::CUSTOM_DATA_START) {
+					const CrossPackData* data = inPack->Serialize();
+					sendBatch.insert(sendBatch.end(), data, data + inPack->GetPacketSize());
+					return inPack->GetPacketSize();
+				}
+				if (!sendBatch.empty())
+					FlushSends(true);
+
 				/* send until succesful */
 				int result;
 				do {
@@ -500,10 +612,14 @@ namespace CrossSock {
 				return NetTransError::STREAM_NOT_BOUND;
 			else {
 
-				/* finalize if necessary */
+				/* finalize if necessary, and check the packet with the server's checksum algorithm */
 				if (!inPack->IsFinalized()) {
 					inPack->Finalize(false, true, GetClientID());
 				}
+				inPack->SetChecksumType(checksumType);
+
+				if (clientProperties.streamAggregateSize > 0)
+					return StagePack(inPack, false);
 
 				/* send until succesful */
 				int result;
@@ -514,6 +630,126 @@ namespace CrossSock {
 			}
 		}
 
+		/*
+		 * Send a message of any size reliably to the server's message handlers - returns the number of bytes sent or queued
+		 * if succesful, or the NetTransError if unsuccesful. Messages too large for a single packet are copied and sent in
+		 * fragments over the following update steps (see CrossClientProperties::fragmentBytesPerUpdate), taking turns with
+		 * other large messages - so messages sent after a large message may be handled before it
+		 */
+		int SendMessageToServer(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize)
+		{
+			return QueueMessage(inDataID, inData, inSize, NetTransMethod::TCP);
+		}
+
+		/*
+		 * Send a message of any size unreliably to the server's message handlers - returns the number of bytes sent or queued
+		 * if succesful, or the NetTransError if unsuccesful. Large messages are sent in fragments as with SendMessageToServer,
+		 * and are lost if any of their fragments are
+		 */
+		int StreamMessageToServer(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize)
+		{
+			return QueueMessage(inDataID, inData, inSize, NetTransMethod::UDP);
+		}
+
+		/* Gets the number of large messages waiting to be sent in fragments */
+		size_t GetNumQueuedMessages() const
+		{
+			return fragmenter.GetNumMessages();
+		}
+
+		/*
+		 * Send a packet unreliably to the server at the end of the update, replacing any packet of the
+		 * same data type sent this way during the frame (latest value wins) - returns the number of bytes
+		 * queued if succesful, or the NetTransError if unsuccesful. WARNING: Will finalize the packet automatically
+		 */
+		int StreamLatestToServer(const CrossPackPtr inPack) const
+		{
+			return StreamLatestToServer(inPack.get());
+		}
+
+		/*
+		 * Send a packet unreliably to the server at the end of the update, replacing any packet of the
+		 * same data type sent this way during the frame (latest value wins) - returns the number of bytes
+		 * queued if succesful, or the NetTransError if unsuccesful. WARNING: Will finalize the packet automatically
+		 */
+		int StreamLatestToServer(const CrossPack* inPack) const
+		{
+			if (clientState == CrossClientState::CLIENT_NEEDS_TO_CONNECT || clientState == CrossClientState::CLIENT_CONNECTING || clientState == CrossClientState::CLIENT_RECONNECTING) {
+				return NetTransError::CLIENT_NOT_CONNECTED;
+			}
+			else if (!streamIsBound)
+				return NetTransError::STREAM_NOT_BOUND;
+			else {
+
+				/* finalize if necessary, and check the packet with the server's checksum algorithm */
+				if (!inPack->IsFinalized()) {
+					inPack->Finalize(false, true, GetClientID());
+				}
+				inPack->SetChecksumType(checksumType);
+
+				return StagePack(inPack, true);
+			}
+		}
+
+		/* Writes the reliable packets batched during this frame */
+		void FlushSends(const bool inShouldBlockUntilSent = true) const
+		{
+			size_t bytesSent = 0;
+			while (serverSocket && bytesSent < sendBatch.size()) {
+				int result = serverSocket->Send(sendBatch.data() + bytesSent, (int)(sendBatch.size() - bytesSent));
+				if (result > 0)
+					bytesSent += result;
+				else if (!inShouldBlockUntilSent || CrossSockUtil::GetLastError() != CrossSockError::WOULDBLOCK)
+					break;
+			}
+
+			/* keep unsent bytes for the next flush */
+			sendBatch.erase(sendBatch.begin(), sendBatch.begin() + bytesSent);
+		}
+
+		/* Sends the unreliable packets staged during this frame - aggregated when streamAggregateSize is set */
+		void FlushStreams(const bool inShouldBlockUntilSent = true) const
+		{
+			if (stagedPacks.empty())
+				return;
+			if (streamSocket && streamIsBound) {
+				int aggregateLimit = clientProperties.streamAggregateSize - CrossPack::GetHeaderSize() - (int)sizeof(CrossClientID);
+				if (aggregateLimit > (int)CrossPack::MAX_PAYLOAD_BYTES)
+					aggregateLimit = CrossPack::MAX_PAYLOAD_BYTES;
+
+				/* packets staged before aggregation was turned off (or with a size too small to share) are sent on their own */
+				if (clientProperties.streamAggregateSize <= 0 || aggregateLimit < 0)
+					aggregateLimit = 0;
+
+				const int flagsPos = sizeof(CrossPackDataID) + sizeof(CrossPackPayloadLen);
+				streamAggregate.ClearPayload();
+				for (size_t p = 0; p < stagedPacks.size(); p++) {
+					const CrossStagedPack& staged = stagedPacks[p];
+					if (staged.length == 0)
+						continue;
+					CrossPackData* data = streamStage.data() + staged.offset;
+
+					/* packets that can't share a datagram are sent on their own - after any earlier packets */
+					int senderSize = CrossSysUtil::CheckBit(data[flagsPos], CrossPackFlagBit::UDP_SUPPORT_FLAG) ? sizeof(CrossClientID) : 0;
+					int packetSize = staged.length - senderSize;
+					if (packetSize > aggregateLimit) {
+						SendStreamAggregate(inShouldBlockUntilSent);
+						SendStaged(data, staged.length, inShouldBlockUntilSent);
+						continue;
+					}
+					if (streamAggregate.GetPayloadSize() + packetSize > aggregateLimit)
+						SendStreamAggregate(inShouldBlockUntilSent);
+
+					/* aggregated packets share the aggregate's sender ID */
+					data[flagsPos] = CrossSysUtil::ClearBit(data[flagsPos], CrossPackFlagBit::UDP_SUPPORT_FLAG);
+					streamAggregate.AddDataToPayload(data, packetSize);
+				}
+				SendStreamAggregate(inShouldBlockUntilSent);
+			}
+			streamStage.clear();
+			stagedPacks.clear();
+		}
+
 		/* Returns true if the UDP socket has been bound - false otherwise */
 		bool IsStreamBound() const
 		{
@@ -605,6 +841,31 @@ namespace CrossSock {
 			return false;
 		}
 
+		/*
+		 * Add a message handler for the given custom data - the event will fire with every message of this data's type
+		 * received from the server, whether it was sent as a single packet or reassembled from fragments
+		 */
+		bool AddMessageHandler(std::string inDataName, void(*inFunction)(const CrossMessage*, NetTransMethod))
+		{
+			GetMessageEvent(inDataName)->AddCallback(inFunction);
+			return true;
+		}
+
+		/*
+		 * Add a message handler for the given custom data - the event will fire on the given object (of type Class) with every
+		 * message of this data's type received from the server, whether it was sent as a single packet or reassembled from fragments
+		 */
+		template <class Class>
+		bool AddMessageHandler(std::string inDataName, void(Class::*inFunction)(const CrossMessage*, NetTransMethod), Class* object)
+		{
+			/* Return failure if the object is a nullptr */
+			if (object == nullptr)
+				return false;
+
+			GetMessageEvent(inDataName)->AddObjectCallback<Class>(inFunction, object);
+			return true;
+		}
+
 		/* Get the custom data ID from a given name */
 		CrossPackDataID GetDataIDFromName(std::string inDataName) const
 		{
@@ -632,7 +893,13 @@ namespace CrossSock {
 		/* Create an empty packet with the given data name - WARNING: this packet must be deleted */
 		CrossPackPtr CreatePack(std::string inDataName) const
 		{
-			return std::make_shared<CrossPack>(GetDataIDFromName(inDataName));
+			return CrossPackPool::Acquire(GetDataIDFromName(inDataName));
+		}
+
+		/* Create an empty packet with the given data name and a single owner */
+		CrossPackUniquePtr CreateUniquePack(std::string inDataName) const
+		{
+			return CrossPackPool::AcquireUnique(GetDataIDFromName(inDataName));
 		}
 
 		/* Get the most recent ping to the server in ms */
@@ -824,6 +1091,7 @@ namespace CrossSock {
 		CrossClientProperties clientProperties;
 		CrossClientState clientState;
 		CrossClientID clientID;
+		CrossChecksumType checksumType;
 		bool streamIsBound;
 		CrossEvent<void>* connectEvent;
 		CrossEvent<void>* readyEvent;
@@ -837,21 +1105,30 @@ namespace CrossSock {
 		std::vector<CrossDataEvent<const CrossPack*, NetTransMethod>* > dataEvents;
 		std::unordered_map<CrossPackDataID, CrossDataEvent<const CrossPack*, NetTransMethod>* > dataEventsByID;
 		std::unordered_map<std::string, CrossDataEvent<const CrossPack*, NetTransMethod>* > dataEventsByName;
+		std::vector<CrossDataEvent<const CrossMessage*, NetTransMethod>*> messageEvents;
+		std::unordered_map<CrossPackDataID, CrossDataEvent<const CrossMessage*, NetTransMethod>*> messageEventsByID;
+		CrossMessageBufferPool messageBufferPool;
+		CrossFragmenter fragmenter;
+		CrossReassembler reassembler;
+		CrossTimer messageClock;
 		int connectionAttempts;
 		CrossTimer connectionTimer;
-		CrossPackData tcpBuffer[CROSS_SOCK_BUFFER_SIZE];
-		CrossBufferLen tcpBufferLength;
-		CrossPackData udpBuffer[CROSS_SOCK_BUFFER_SIZE];
-		CrossBufferLen udpBufferLength;
+		CrossRingBufferPtr tcpBuffer;
+		std::vector<CrossPackData> udpDatagramData;
+		std::vector<CrossDatagram> udpDatagrams;
 		CrossTimer alivenessTestTimer;
 		CrossTimer timeoutTimer;
 		double timeoutDelay;
 		double ping;
+		mutable std::vector<CrossPackData> sendBatch;
+		mutable std::vector<CrossPackData> streamStage;
+		mutable std::vector<CrossStagedPack> stagedPacks;
+		mutable CrossPack streamAggregate;
+		int64_t receiveTime;
 
 		/* 
-		 * receive function for when raw data is received - this is where the majority of
-		 * the connection process is implemented. In addition, this function is responsible
-		 * for calling custom data events.
+		 * receive function for when raw data is received - frames the next packet in the
+		 * data and returns the number of bytes it used
 		 */
 		CrossBufferLen OnReceiveNewData(CrossPackData* inData, CrossBufferLen inLength, NetTransMethod inMethod) {
 			if (inLength >= CrossPack::GetHeaderSize()) {
@@ -864,167 +1141,418 @@ namespace CrossSock {
 				if (header.payloadSize + CrossPack::GetHeaderSize() + CrossPack::GetFooterLength(header) <= inLength) {
 					CrossPackFooter footer = CrossPack::PeakFooter(inData, header);
 					CrossPack inPack(header, footer, inData);
-					if (inPack.GetDataID() == StaticDataID::HANDSHAKE) {
-						if (clientState == CrossClientState::CLIENT_RECEIVING_ID || clientID == 0)
-						{
-							CrossPack pack;
-							pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
-							SendToServer(&pack);
-						}
-						else
-						{
-							CrossPack pack;
-							pack.SetDataID(StaticDataID::RECONNECT_PACK);
-							pack.AddToPayload<CrossClientID>(clientID);
-							SendToServer(&pack);
-						}
-						if (handshakeEvent && handshakeEvent->IsValid())
-							handshakeEvent->Execute();
+					inPack.SetReceiveTime(receiveTime);
+					if (inPack.GetDataID() == StaticDataID::AGGREGATE_PACK) {
+						OnReceiveAggregate(inPack, inData, inMethod);
+					}
+					else {
+						OnReceivePack(inPack, inMethod);
 					}
-					else if (inPack.GetDataID() == StaticDataID::INIT_CLIENT_ID || inPack.GetDataID() == StaticDataID::RECONNECT_PACK) {
 
-						// reset timeout
-						timeoutTimer.SetToNow();
-						timeoutDelay = CROSS_SOCK_MAX_TIMEOUT;
-						ping = 0;
+					/* return packet size */
+					return inPack.GetPacketSize();
+				}
+			}
 
-						// send aliveness test
-						CrossPack alivenessTest;
-						alivenessTest.SetDataID(StaticDataID::ALIVENESS_TEST);
-						alivenessTest.AddToPayload<float>((float)((clientProperties.alivenessTestDelay + ping) * CROSS_SOCK_TIMEOUT_FACTOR));
-						SendToServer(&alivenessTest);
-
-						// check incoming ID
-						CrossClientID newID = inPack.RemoveFromPayload<CrossClientID>();
-						clientState = CrossClientState::CLIENT_RECEIVING_DATA_LIST;
-						if (newID != 0) {
-							clientID = newID;
-							if (inPack.GetDataID() == StaticDataID::RECONNECT_PACK) {
-								if (reconnectEvent && reconnectEvent->IsValid())
-									reconnectEvent->Execute();
-							}
-							else {
-								if (clientState == CrossClientState::CLIENT_REQUESTING_ID && failedReconnectEvent && failedReconnectEvent->IsValid())
-									failedReconnectEvent->Execute();
-								if (connectEvent && connectEvent->IsValid())
-									connectEvent->Execute();
-							}
-							CrossPack pack;
-							pack.SetDataID(StaticDataID::INIT_CUSTOM_DATA_LIST);
-							SendToServer(&pack);
-						}
-						else { /* resend id request packet */
-							CrossPack pack;
-							if (clientState == CrossClientState::CLIENT_RECEIVING_ID) {
-								pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
-							}
-							else {
-								pack.SetDataID(StaticDataID::RECONNECT_PACK);
-								pack.AddToPayload<CrossClientID>(clientID);
-							}
-							SendToServer(&pack);
-						}
+			/* return 0 - no buffer data used */
+			return 0;
+		}
+
+		/*
+		 * receive function for a single packet - this is where the majority of the
+		 * connection process is implemented. In addition, this function is responsible
+		 * for calling custom data events.
+		 */
+		void OnReceivePack(const CrossPack& inPack, NetTransMethod inMethod)
+		{
+			if (inPack.GetDataID() == StaticDataID::HANDSHAKE) {
+
+				/* adopt the server's checksum algorithm - servers that don't name one use the byte sum */
+				checksumType = CrossChecksumType::CHECKSUM_SUM;
+				if (inPack.GetPayloadSize() >= sizeof(unsigned char)) {
+					unsigned char serverChecksumType = inPack.RemoveFromPayload<unsigned char>();
+					if (serverChecksumType <= CrossChecksumType::CHECKSUM_NONE)
+						checksumType = (CrossChecksumType)serverChecksumType;
+				}
+
+				/* the adopted algorithm is sent back, so that the server knows this client can check it */
+				if (clientState == CrossClientState::CLIENT_RECEIVING_ID || clientID == 0)
+				{
+					CrossPack pack;
+					pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
+					pack.AddToPayload<unsigned char>((unsigned char)checksumType);
+					SendToServer(&pack);
+				}
+				else
+				{
+					CrossPack pack;
+					pack.SetDataID(StaticDataID::RECONNECT_PACK);
+					pack.AddToPayload<CrossClientID>(clientID);
+					pack.AddToPayload<unsigned char>((unsigned char)checksumType);
+					SendToServer(&pack);
+				}
+				if (handshakeEvent && handshakeEvent->IsValid())
+					handshakeEvent->Execute();
+			}
+			else if (inPack.GetDataID() == StaticDataID::INIT_CLIENT_ID || inPack.GetDataID() == StaticDataID::RECONNECT_PACK) {
+
+				// reset timeout
+				timeoutTimer.SetToNow();
+				timeoutDelay = CROSS_SOCK_MAX_TIMEOUT;
+				ping = 0;
+
+				// send aliveness test
+				CrossPack alivenessTest;
+				alivenessTest.SetDataID(StaticDataID::ALIVENESS_TEST);
+				alivenessTest.AddToPayload<float>((float)((clientProperties.alivenessTestDelay + ping) * CROSS_SOCK_TIMEOUT_FACTOR));
+				SendToServer(&alivenessTest);
+
+				// check incoming ID
+				CrossClientID newID = inPack.RemoveFromPayload<CrossClientID>();
+				clientState = CrossClientState::CLIENT_RECEIVING_DATA_LIST;
+				if (newID != 0) {
+					clientID = newID;
+					if (inPack.GetDataID() == StaticDataID::RECONNECT_PACK) {
+						if (reconnectEvent && reconnectEvent->IsValid())
+							reconnectEvent->Execute();
 					}
-					else if (inPack.GetDataID() == StaticDataID::DISCONNECT_PACK) {
-						Disconnect();
+					else {
+						if (clientState == CrossClientState::CLIENT_REQUESTING_ID && failedReconnectEvent && failedReconnectEvent->IsValid())
+							failedReconnectEvent->Execute();
+						if (connectEvent && connectEvent->IsValid())
+							connectEvent->Execute();
 					}
-					else if (inPack.GetDataID() == StaticDataID::INIT_CUSTOM_DATA_LIST) {
-
-						// get data from packet
-						CrossPackPayloadLen numCustomData = inPack.RemoveFromPayload<CrossPackPayloadLen>();
-						CrossPackPayloadLen customDataIndex = inPack.RemoveFromPayload<CrossPackPayloadLen>();
-						std::string dataName = inPack.RemoveStringFromPayload();
-						CrossPackDataID dataID = inPack.RemoveFromPayload<CrossPackDataID>();
-
-						// look for existing data event
-						bool foundMatch = false;
-						for (size_t x = 0; x < dataEvents.size(); x++) {
-							auto dataEvent = dataEvents[x];
-							if (dataEvent) {
-								if (dataEvent->name == dataName) {
-									foundMatch = true;
-									dataEvent->dataID = dataID;
-									break;
-								}
-							}
+					CrossPack pack;
+					pack.SetDataID(StaticDataID::INIT_CUSTOM_DATA_LIST);
+					SendToServer(&pack);
+				}
+				else { /* resend id request packet */
+					CrossPack pack;
+					if (clientState == CrossClientState::CLIENT_RECEIVING_ID) {
+						pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
+					}
+					else {
+						pack.SetDataID(StaticDataID::RECONNECT_PACK);
+						pack.AddToPayload<CrossClientID>(clientID);
+					}
+					SendToServer(&pack);
+				}
+			}
+			else if (inPack.GetDataID() == StaticDataID::DISCONNECT_PACK) {
+				Disconnect();
+			}
+			else if (inPack.GetDataID() == StaticDataID::INIT_CUSTOM_DATA_LIST) {
+
+				// get data from packet
+				CrossPackPayloadLen numCustomData = inPack.RemoveFromPayload<CrossPackPayloadLen>();
+				CrossPackPayloadLen customDataIndex = inPack.RemoveFromPayload<CrossPackPayloadLen>();
+				std::string dataName = inPack.RemoveStringFromPayload();
+				CrossPackDataID dataID = inPack.RemoveFromPayload<CrossPackDataID>();
+
+				// look for existing data event
+				bool foundMatch = false;
+				for (size_t x = 0; x < dataEvents.size(); x++) {
+					auto dataEvent = dataEvents[x];
+					if (dataEvent) {
+						if (dataEvent->name == dataName) {
+							foundMatch = true;
+							dataEvent->dataID = dataID;
+							break;
 						}
+					}
+				}
 
-						// add new data event if no match was found
-						if (!foundMatch) {
-							CrossDataEvent<const CrossPack*, NetTransMethod>* newEvent = new CrossDataEvent<const CrossPack*, NetTransMethod>(dataName);
-							newEvent->dataID = dataID;
-							dataEvents.push_back(newEvent);
-						}
+				// add new data event if no match was found
+				if (!foundMatch) {
+					CrossDataEvent<const CrossPack*, NetTransMethod>* newEvent = new CrossDataEvent<const CrossPack*, NetTransMethod>(dataName);
+					newEvent->dataID = dataID;
+					dataEvents.push_back(newEvent);
+				}
 
-						// set state to connected if at the end of the custom data
-						if (IsReady() || customDataIndex >= numCustomData - 1) {
-							FillDataEventMaps();
-							if (!IsReady()) {
-								CrossPack outPack;
-								outPack.SetDataID(StaticDataID::HANDSHAKE);
-								SendToServer(&outPack);
-								clientState = CrossClientState::CLIENT_CONNECTED;
-								if (readyEvent && readyEvent->IsValid())
-									readyEvent->Execute();
-							}
-						}
+				// set state to connected if at the end of the custom data
+				if (IsReady() || customDataIndex >= numCustomData - 1) {
+					FillDataEventMaps();
+					if (!IsReady()) {
+						CrossPack outPack;
+						outPack.SetDataID(StaticDataID::HANDSHAKE);
+						SendToServer(&outPack);
+						clientState = CrossClientState::CLIENT_CONNECTED;
+						if (readyEvent && readyEvent->IsValid())
+							readyEvent->Execute();
 					}
-					else if (inPack.GetDataID() == StaticDataID::ALIVENESS_TEST) {
+				}
+			}
+			else if (inPack.GetDataID() == StaticDataID::ALIVENESS_TEST) {
 
-						/* clock in ping */
-						ping = timeoutTimer.GetElapsedTime() - timeoutDelay;
-						if (ping < 0.0) {
-							ping = 0.0;
-						}
+				/* clock in ping */
+				ping = timeoutTimer.GetElapsedTime() - timeoutDelay;
+				if (ping < 0.0) {
+					ping = 0.0;
+				}
 
-						/* reset timeout timer and update expected timeout delay */
-						timeoutTimer.SetToNow();
-						timeoutDelay = inPack.RemoveFromPayload<float>();
-					}
-					else { /* custom or unknown data */
+				/* reset timeout timer and update expected timeout delay */
+				timeoutTimer.SetToNow();
+				timeoutDelay = inPack.RemoveFromPayload<float>();
+			}
+			else if (inPack.GetDataID() == StaticDataID::FRAGMENT_PACK && (inMethod == NetTransMethod::TCP || inPack.IsValid())) {
+				OnReceiveFragment(inPack, inMethod);
+			}
+			else { /* custom or unknown data */
 
-						   /* call receive events if data ID is known and the packet is valid */
-						if (inPack.GetDataID() != StaticDataID::UNKNOWN_PACK && (inMethod == NetTransMethod::TCP || inPack.IsValid())) {
+				   /* call receive events if data ID is known and the packet is valid */
+				if (inPack.GetDataID() != StaticDataID::UNKNOWN_PACK && (inMethod == NetTransMethod::TCP || inPack.IsValid())) {
 
-							/* find custom event if it exists */
-							auto dataEvent = dataEventsByID.find(inPack.GetDataID());
+					/* find custom event if it exists */
+					auto dataEvent = dataEventsByID.find(inPack.GetDataID());
 
-							/* call receive event if it is valid */
-							if (receiveEvent && receiveEvent->IsValid()) {
-								receiveEvent->Execute(&inPack, inMethod);
-								inPack.Reset();
-							}
+					/* call receive event if it is valid */
+					if (receiveEvent && receiveEvent->IsValid()) {
+						receiveEvent->Execute(&inPack, inMethod);
+						inPack.Reset();
+					}
 
-							/* call each custom event callback until finished or disconnected */
-							if (IsRunning() && dataEvent != dataEventsByID.end()) {
-								for (int c = dataEvent->second->GetNumCallbacks() - 1; c >= 0; c--) {
-									if (IsDisconnected()) {
-										break;
-									}
-									dataEvent->second->Execute(c, &inPack, inMethod);
-									inPack.Reset();
-								}
+					/* call each custom event callback until finished or disconnected */
+					if (IsRunning() && dataEvent != dataEventsByID.end()) {
+						for (int c = dataEvent->second->GetNumCallbacks() - 1; c >= 0; c--) {
+							if (IsDisconnected()) {
+								break;
 							}
+							dataEvent->second->Execute(c, &inPack, inMethod);
+							inPack.Reset();
 						}
-						else { /* else data ID is unknown or checksum is invalid - call transmit error event */
-							if (transErrorEvent && transErrorEvent->IsValid()) {
-								NetTransError err;
-								if (inPack.GetDataID() != StaticDataID::UNKNOWN_PACK)
-									err = NetTransError::INVALID_DATA_ID;
-								else
-									err = NetTransError::INVALID_CHECKSUM;
-								transErrorEvent->Execute(&inPack, inMethod, err);
-							}
+					}
+
+					/* single packet messages go to the message handlers as well */
+					if (!messageEventsByID.empty()) {
+						auto messageEvent = messageEventsByID.find(inPack.GetDataID());
+						if (messageEvent != messageEventsByID.end()) {
+							CrossMessage message(inPack.GetDataID(), inPack.GetView().GetPayload(), inPack.GetPayloadSize(), inPack.GetReceiveTime());
+							OnReceiveMessage(message, messageEvent->second, inMethod);
 						}
 					}
+				}
+				else { /* else data ID is unknown or checksum is invalid - call transmit error event */
+					if (transErrorEvent && transErrorEvent->IsValid()) {
+						NetTransError err;
+						if (inPack.GetDataID() != StaticDataID::UNKNOWN_PACK)
+							err = NetTransError::INVALID_DATA_ID;
+						else
+							err = NetTransError::INVALID_CHECKSUM;
+						transErrorEvent->Execute(&inPack, inMethod, err);
+					}
+				}
+			}
+		}
 
-					/* return packet size */
-					return inPack.GetPacketSize();
+		/* Sends a message as a single packet if it fits, or queues it to be sent in fragments */
+		int QueueMessage(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize, NetTransMethod inMethod)
+		{
+			if (clientState != CrossClientState::CLIENT_CONNECTED)
+				return NetTransError::CLIENT_NOT_CONNECTED;
+			else if (inMethod == NetTransMethod::UDP && !streamIsBound)
+				return NetTransError::STREAM_NOT_BOUND;
+			else if (inDataID < StaticDataID::CUSTOM_DATA_START)
+				return NetTransError::INVALID_DATA_ID;
+
+			if (inSize <= CrossPack::MAX_PAYLOAD_BYTES) {
+				CrossPack pack(inDataID);
+				pack.AddDataToPayload(inData, (CrossPackPayloadLen)inSize);
+				if (inMethod == NetTransMethod::TCP)
+					return SendToServer(&pack);
+				return StreamToServer(&pack);
+			}
+			fragmenter.Queue(inDataID, inData, inSize, inMethod, messageBufferPool);
+			return (int)inSize;
+		}
+
+		/* Sends the next fragments of the queued messages while this update step's fragment budget allows */
+		void FlushFragments()
+		{
+			CrossPack fragment;
+			CrossPackDataID dataID;
+			NetTransMethod method;
+			int bytesSent = 0;
+			while (bytesSent < clientProperties.fragmentBytesPerUpdate && IsConnected() && fragmenter.NextFragment(fragment, dataID, method)) {
+
+				/* send without blocking - a fragment that doesn't go out is tried again next update */
+				if (method == NetTransMethod::TCP) {
+					if (!sendBatch.empty())
+						FlushSends(false);
+					if (!sendBatch.empty())
+						break;
+					int result = serverSocket->Send(fragment.Serialize(), fragment.GetPacketSize());
+					if (result <= 0)
+						break;
+
+					/* the rest of a fragment cut short goes out with the next flush */
+					if (result < fragment.GetPacketSize())
+						sendBatch.assign(fragment.Serialize() + result, fragment.Serialize() + fragment.GetPacketSize());
+				}
+				else if (streamIsBound) {
+					fragment.Finalize(false, true, GetClientID());
+					if (SendStaged(fragment.Serialize(), fragment.GetPacketSize(), false) < 0)
+						break;
+				}
+				else {
+					break;
 				}
+
+				fragmenter.PopFragment(messageBufferPool);
+				bytesSent += fragment.GetPacketSize();
+				if (!sendBatch.empty())
+					break;
 			}
+		}
 
-			/* return 0 - no buffer data used */
-			return 0;
+		/* Adds a received fragment to its message, and handles the message once it is whole */
+		void OnReceiveFragment(const CrossPack& inPack, NetTransMethod inMethod)
+		{
+			CrossPackDataID dataID;
+			std::vector<CrossPackData> messageData;
+			CrossFragmentResult result = reassembler.AddFragment(inPack, messageClock.GetElapsedTime(), (uint32_t)clientProperties.maxMessageSize, (size_t)clientProperties.maxReassemblyBytes, messageBufferPool, dataID, messageData);
+			if (result == CrossFragmentResult::FRAGMENT_REJECTED) {
+				if (transErrorEvent && transErrorEvent->IsValid())
+					transErrorEvent->Execute(&inPack, inMethod, NetTransError::INVALID_PAYLOAD_SIZE);
+			}
+			else if (result == CrossFragmentResult::FRAGMENT_COMPLETE) {
+				auto messageEvent = messageEventsByID.find(dataID);
+				if (messageEvent != messageEventsByID.end()) {
+					CrossMessage message(dataID, messageData.data(), (uint32_t)messageData.size(), inPack.GetReceiveTime());
+					OnReceiveMessage(message, messageEvent->second, inMethod);
+				}
+				else if (transErrorEvent && transErrorEvent->IsValid()) {
+					transErrorEvent->Execute(&inPack, inMethod, NetTransError::INVALID_DATA_ID);
+				}
+				messageBufferPool.Release(messageData);
+			}
+		}
+
+		/* Calls each callback of a message event until finished or disconnected */
+		void OnReceiveMessage(const CrossMessage& inMessage, CrossDataEvent<const CrossMessage*, NetTransMethod>* inEvent, NetTransMethod inMethod)
+		{
+			for (int c = (int)inEvent->GetNumCallbacks() - 1; c >= 0; c--) {
+				if (IsDisconnected()) {
+					break;
+				}
+				inEvent->Execute(c, &inMessage, inMethod);
+			}
+		}
+
+		/* Finds or adds the message event of the given custom data - its data ID is filled in once the server's data list arrives */
+		CrossDataEvent<const CrossMessage*, NetTransMethod>* GetMessageEvent(std::string inDataName)
+		{
+			/* truncate name if too long */
+			if (inDataName.length() > CROSS_SOCK_MAX_DATA_NAME_LENGTH)
+				inDataName.resize(CROSS_SOCK_MAX_DATA_NAME_LENGTH);
+
+			for (size_t m = 0; m < messageEvents.size(); m++) {
+				if (messageEvents[m]->name == inDataName)
+					return messageEvents[m];
+			}
+			CrossDataEvent<const CrossMessage*, NetTransMethod>* newEvent = new CrossDataEvent<const CrossMessage*, NetTransMethod>(inDataName);
+			newEvent->dataID = StaticDataID::UNKNOWN_PACK;
+			messageEvents.push_back(newEvent);
+			if (IsReady()) {
+				auto dataEvent = dataEventsByName.find(inDataName);
+				if (dataEvent != dataEventsByName.end()) {
+					newEvent->dataID = dataEvent->second->dataID;
+					messageEventsByID[newEvent->dataID] = newEvent;
+				}
+			}
+			return newEvent;
+		}
+
+		/* Allocates the slots datagrams are received into */
+		void AllocateDatagramSlots()
+		{
+			udpDatagramData = std::vector<CrossPackData>(UDPSocket::MAX_RECEIVE_BATCH * (CrossPack::GetMaxPacketSize() + 1));
+			udpDatagrams.resize(UDPSocket::MAX_RECEIVE_BATCH);
+			for (size_t d = 0; d < udpDatagrams.size(); d++) {
+				udpDatagrams[d].data = udpDatagramData.data() + d * (CrossPack::GetMaxPacketSize() + 1);
+				udpDatagrams[d].capacity = CrossPack::GetMaxPacketSize() + 1;
+			}
+		}
+
+		/* receive function for a single datagram - datagrams are framed on their own, so a bad datagram can't affect the next */
+		void OnReceiveDatagram(const CrossDatagram& inDatagram)
+		{
+			if (inDatagram.truncated) {
+				if (transErrorEvent && transErrorEvent->IsValid())
+					transErrorEvent->Execute(nullptr, NetTransMethod::UDP, NetTransError::INVALID_PAYLOAD_SIZE);
+				return;
+			}
+			receiveTime = inDatagram.receiveTime;
+			CrossBufferLen dataUsed;
+			CrossBufferLen bufferPos = 0;
+			do {
+				dataUsed = OnReceiveNewData(inDatagram.data + bufferPos, inDatagram.length - bufferPos, NetTransMethod::UDP);
+				bufferPos += dataUsed;
+			} while (IsRunning() && streamIsBound && dataUsed > 0 && bufferPos < (CrossBufferLen)inDatagram.length);
+		}
+
+		/* Unpacks each packet of an aggregate packet - the packets are sent without their sender ID and share the aggregate's */
+		void OnReceiveAggregate(const CrossPack& inAggregate, CrossPackData* inData, NetTransMethod inMethod)
+		{
+			CrossBufferLen aggregateEnd = CrossPack::GetHeaderSize() + inAggregate.GetPayloadSize();
+			CrossBufferLen bufferPos = CrossPack::GetHeaderSize();
+			while (bufferPos + CrossPack::GetHeaderSize() <= aggregateEnd && IsRunning()) {
+				CrossPackHeader header = CrossPack::PeakHeader(inData + bufferPos);
+				CrossBufferLen packetSize = CrossPack::GetHeaderSize() + header.payloadSize + CrossPack::GetFooterLength(header);
+				if (header.dataID == StaticDataID::AGGREGATE_PACK || bufferPos + packetSize > aggregateEnd) {
+					if (transErrorEvent && transErrorEvent->IsValid())
+						transErrorEvent->Execute(nullptr, inMethod, NetTransError::INVALID_PAYLOAD_SIZE);
+					return;
+				}
+				CrossPackFooter footer = CrossPack::PeakFooter(inData + bufferPos, header);
+				footer.senderID = inAggregate.GetSenderID();
+				header.packFlags = CrossSysUtil::SetBit(header.packFlags, CrossPackFlagBit::UDP_SUPPORT_FLAG);
+				CrossPack inPack(header, footer, inData + bufferPos);
+				inPack.SetReceiveTime(receiveTime);
+				OnReceivePack(inPack, inMethod);
+				bufferPos += packetSize;
+			}
+		}
+
+		/* Copies a finalized packet into the stream stage - replacing an earlier replaceable packet of the same data type if requested */
+		int StagePack(const CrossPack* inPack, bool inIsReplaceable) const
+		{
+			if (inIsReplaceable) {
+				for (size_t p = 0; p < stagedPacks.size(); p++) {
+					if (stagedPacks[p].isReplaceable && stagedPacks[p].dataID == inPack->GetDataID())
+						stagedPacks[p].length = 0;
+				}
+			}
+
+			CrossStagedPack staged;
+			staged.dataID = inPack->GetDataID();
+			staged.offset = streamStage.size();
+			staged.length = inPack->GetPacketSize();
+			staged.isReplaceable = inIsReplaceable;
+			const CrossPackData* data = inPack->Serialize();
+			streamStage.insert(streamStage.end(), data, data + staged.length);
+			stagedPacks.push_back(staged);
+			return staged.length;
+		}
+
+		/* Sends staged packet data to the server */
+		int SendStaged(const CrossPackData* inData, int inLength, const bool inShouldBlockUntilSent) const
+		{
+			/* send until succesful */
+			int result;
+			do {
+				result = streamSocket->SendTo(inData, inLength, serverAddress);
+			} while (inShouldBlockUntilSent && result < 0 && CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK);
+			return result;
+		}
+
+		/* Sends the aggregate datagram if it holds any packets */
+		void SendStreamAggregate(const bool inShouldBlockUntilSent) const
+		{
+			if (streamAggregate.GetPayloadSize() == 0)
+				return;
+			streamAggregate.Finalize(false, true, GetClientID());
+			SendStaged(streamAggregate.Serialize(), streamAggregate.GetPacketSize(), inShouldBlockUntilSent);
+			streamAggregate.ClearPayload();
 		}
 
 		/* Fills the data event hash tables for ~O(k) access */
@@ -1034,6 +1562,13 @@ namespace CrossSock {
 				dataEventsByID[dataEvents[d]->dataID] = dataEvents[d];
 				dataEventsByName[dataEvents[d]->name] = dataEvents[d];
 			}
+			for (size_t m = 0; m < messageEvents.size(); m++) {
+				auto dataEvent = dataEventsByName.find(messageEvents[m]->name);
+				if (dataEvent != dataEventsByName.end()) {
+					messageEvents[m]->dataID = dataEvent->second->dataID;
+					messageEventsByID[messageEvents[m]->dataID] = messageEvents[m];
+				}
+			}
 		}
 
 		/* Resets data event hash tables */
@@ -1044,6 +1579,10 @@ namespace CrossSock {
 			for (size_t d = 0; d < dataEvents.size(); d++) {
 				dataEvents[d]->dataID = StaticDataID::UNKNOWN_PACK;
 			}
+			messageEventsByID.clear();
+			for (size_t m = 0; m < messageEvents.size(); m++) {
+				messageEvents[m]->dataID = StaticDataID::UNKNOWN_PACK;
+			}
 		}
 	};
 
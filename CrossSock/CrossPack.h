@@ -30,9 +30,20 @@
  * to begin reading from the front again. Likewise, the Clear() function will drop the payload size to 0 and
  * effectively remove all data from the payload, but the actual memory allocation doesn't change until the
  * destructor!
+ *
+ * Packets take their buffer from a shared pool (see CrossPackPool), while CrossPackT<Capacity> holds a small
+ * buffer inline so that it can live on the stack without any allocation.
+ *
+ * For reading without altering a packet, CrossPackView frames serialized data in place and CrossPackReader
+ * keeps its own read position - so several readers can walk the same packet at once.
  */
 
 #include <memory>
+#include <new>
+#include <deque>
+#include <unordered_map>
+#include <limits>
+#include <algorithm>
 #include "CrossUtil.h"
 
 namespace CrossSock {
@@ -69,11 +80,11 @@ namespace CrossSock {
 		/* Custom user flag - WARNING: support for custom header flags may change in future updates, as support for additional features may change */
 		CUSTOM_FLAG_4 = 5,
 
-		/* Custom user flag - WARNING: support for custom header flags may change in future updates, as support for additional features may change */
-		CUSTOM_FLAG_5 = 6,
+		/* Low bit of the algorithm of this packet's checksum (see CrossChecksumType) */
+		CHECKSUM_TYPE_FLAG_1 = 6,
 
-		/* Custom user flag - WARNING: support for custom header flags may change in future updates, as support for additional features may change */
-		CUSTOM_FLAG_6 = 7
+		/* High bit of the algorithm of this packet's checksum (see CrossChecksumType) */
+		CHECKSUM_TYPE_FLAG_2 = 7
 	};
 
 	typedef unsigned int CrossClientID;
@@ -110,6 +121,397 @@ namespace CrossSock {
 		}
 	};
 
+	/*
+	 * Read-only view of a serialized packet - the header and footer are decoded once and the payload
+	 * is never copied. A view has no read position, so any number of CrossPackReaders may share it.
+	 * WARNING: the view does not own its data, which must outlive it
+	 */
+	class CrossPackView {
+	public:
+
+		/* Empty constructor - yields an invalid view */
+		CrossPackView()
+		{
+			payload = nullptr;
+			receiveTime = 0;
+			isValid = false;
+		}
+
+		/* Framing constructor - the view is invalid if the data doesn't hold a whole packet */
+		CrossPackView(const CrossPackData* inData, CrossBufferLen inLength)
+		{
+			payload = nullptr;
+			receiveTime = 0;
+			isValid = false;
+			if (!inData || inLength < (CrossBufferLen)sizeof(CrossPackHeader))
+				return;
+			header.dataID = CrossSysUtil::LoadLittleEndian<CrossPackDataID>(inData);
+			header.payloadSize = CrossSysUtil::LoadLittleEndian<CrossPackPayloadLen>(inData + sizeof(CrossPackDataID));
+			header.packFlags = inData[sizeof(CrossPackDataID) + sizeof(CrossPackPayloadLen)];
+			if (GetPacketSize() > inLength)
+				return;
+			payload = inData + sizeof(CrossPackHeader);
+			const CrossPackData* footerData = payload + header.payloadSize;
+			if (GetPacketFlag(CrossPackFlagBit::CHECKSUM_FLAG)) {
+				footer.checksum = CrossSysUtil::LoadLittleEndian<CrossPackChecksum>(footerData);
+				footerData += sizeof(CrossPackChecksum);
+			}
+			if (GetPacketFlag(CrossPackFlagBit::UDP_SUPPORT_FLAG))
+				footer.senderID = CrossSysUtil::LoadLittleEndian<CrossClientID>(footerData);
+			isValid = true;
+		}
+
+		/* Component constructor - the payload must point to the first payload byte */
+		CrossPackView(const CrossPackHeader& inHeader, const CrossPackFooter& inFooter, const CrossPackData* inPayload, int64_t inReceiveTime = 0)
+		{
+			header = inHeader;
+			footer = inFooter;
+			payload = inPayload;
+			receiveTime = inReceiveTime;
+			isValid = (inPayload != nullptr || inHeader.payloadSize == 0);
+		}
+
+		/* Returns true if this view frames a whole packet */
+		bool IsValid() const
+		{
+			return isValid;
+		}
+
+		/* Get the viewed packet's data ID */
+		CrossPackDataID GetDataID() const
+		{
+			return header.dataID;
+		}
+
+		/* Returns the viewed packet's payload size in bytes */
+		CrossPackPayloadLen GetPayloadSize() const
+		{
+			return header.payloadSize;
+		}
+
+		/* Returns the viewed packet's size in bytes - including the header, payload, and footer */
+		CrossBufferLen GetPacketSize() const
+		{
+			return sizeof(CrossPackHeader) + header.payloadSize + GetFooterSize();
+		}
+
+		/* Returns the size of the viewed packet's footer in bytes */
+		CrossPackPayloadLen GetFooterSize() const
+		{
+			return (GetPacketFlag(CrossPackFlagBit::CHECKSUM_FLAG) ? sizeof(CrossPackChecksum) : 0)
+				+ (GetPacketFlag(CrossPackFlagBit::UDP_SUPPORT_FLAG) ? sizeof(CrossClientID) : 0);
+		}
+
+		/* Returns the first byte of the viewed packet's payload */
+		const CrossPackData* GetPayload() const
+		{
+			return payload;
+		}
+
+		/* Check one of the viewed packet's flag values */
+		bool GetPacketFlag(const CrossPackFlagBit& inFlag) const
+		{
+			return CrossSysUtil::CheckBit(header.packFlags, inFlag);
+		}
+
+		/* Returns the viewed packet's decoded header */
+		const CrossPackHeader& GetHeader() const
+		{
+			return header;
+		}
+
+		/* Returns the viewed packet's decoded footer */
+		const CrossPackFooter& GetFooter() const
+		{
+			return footer;
+		}
+
+		/* Gets the viewed packet's client ID - WARNING: users should also check the UDP_SUPPORT_FLAG to see if this client ID is valid */
+		CrossClientID GetSenderID() const
+		{
+			return footer.senderID;
+		}
+
+		/* Gets the viewed packet's transmitted checksum - WARNING: users should also check the CHECKSUM_FLAG to see if this checksum is valid */
+		CrossPackChecksum GetChecksum() const
+		{
+			return footer.checksum;
+		}
+
+		/* Gets the kernel receive time of the viewed packet in nanoseconds since the epoch - 0 if it wasn't recorded */
+		int64_t GetReceiveTime() const
+		{
+			return receiveTime;
+		}
+
+		/* Sets the kernel receive time of the viewed packet */
+		void SetReceiveTime(int64_t inReceiveTime)
+		{
+			receiveTime = inReceiveTime;
+		}
+
+	private:
+		CrossPackHeader header;
+		CrossPackFooter footer;
+		const CrossPackData* payload;
+		int64_t receiveTime;
+		bool isValid;
+	};
+
+	/*
+	 * A message of any size, delivered to message handlers - either the payload of a single packet or a
+	 * message reassembled from fragments. Its data is only valid while it is being handled.
+	 */
+	class CrossMessage {
+	public:
+
+		/* Component constructor */
+		CrossMessage(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize, int64_t inReceiveTime = 0)
+		{
+			dataID = inDataID;
+			data = inData;
+			size = inSize;
+			receiveTime = inReceiveTime;
+		}
+
+		/* Returns the message's data ID */
+		CrossPackDataID GetDataID() const
+		{
+			return dataID;
+		}
+
+		/* Returns the message's data */
+		const CrossPackData* GetData() const
+		{
+			return data;
+		}
+
+		/* Returns the size of the message's data in bytes */
+		uint32_t GetSize() const
+		{
+			return size;
+		}
+
+		/* Returns the kernel receive time (ns since the epoch) of the message's last packet - 0 if not recorded */
+		int64_t GetReceiveTime() const
+		{
+			return receiveTime;
+		}
+
+	private:
+		CrossPackDataID dataID;
+		const CrossPackData* data;
+		uint32_t size;
+		int64_t receiveTime;
+	};
+
+	/*
+	 * Read cursor over a packet view's payload or a message - reads never allocate (except for strings) and never
+	 * read past the payload. Once a read fails the reader is marked as overrun and all further reads fail
+	 */
+	class CrossPackReader {
+	public:
+
+		/* View constructor */
+		CrossPackReader(const CrossPackView& inView)
+		{
+			payload = inView.GetPayload();
+			length = inView.IsValid() ? inView.GetPayloadSize() : 0;
+			readIdx = 0;
+			hasOverrun = false;
+		}
+
+		/* Message constructor */
+		CrossPackReader(const CrossMessage& inMessage)
+		{
+			payload = inMessage.GetData();
+			length = inMessage.GetSize();
+			readIdx = 0;
+			hasOverrun = false;
+		}
+
+		/* Read data type from payload - returns false if there isn't enough data left */
+		template<class T>
+		bool Read(T& outData, bool autoEndianSwap = true)
+		{
+			if (!Require(sizeof(T)))
+				return false;
+			if (autoEndianSwap)
+				outData = CrossSysUtil::LoadLittleEndian<T>(payload + readIdx);
+			else
+				memcpy(&outData, payload + readIdx, sizeof(T));
+			readIdx += sizeof(T);
+			return true;
+		}
+
+		/* Read data type from payload - returns 0 and marks this reader as overrun if there isn't enough data left */
+		template<class T>
+		T Read(bool autoEndianSwap = true)
+		{
+			T outData = T();
+			Read(outData, autoEndianSwap);
+			return outData;
+		}
+
+		/* Read a span of raw data in place - returns nullptr if there isn't enough data left */
+		const CrossPackData* ReadSpan(uint32_t inLength)
+		{
+			if (!Require(inLength))
+				return nullptr;
+			const CrossPackData* outSpan = payload + readIdx;
+			readIdx += inLength;
+			return outSpan;
+		}
+
+		/* Read string (CrossPackPayloadLen{string length} + char*{string}) from payload */
+		bool ReadString(std::string& outStr)
+		{
+			CrossPackPayloadLen strLength;
+			uint32_t startIdx = readIdx;
+			if (!Read(strLength))
+				return false;
+			const CrossPackData* strData = ReadSpan(strLength);
+			if (!strData) {
+				readIdx = startIdx;
+				return false;
+			}
+			outStr.assign(strData, strLength);
+			return true;
+		}
+
+		/* Read varint from payload */
+		bool ReadVarint(uint64_t& outValue)
+		{
+			if (hasOverrun)
+				return false;
+			int varintLength = CrossSysUtil::DecodeVarint((const unsigned char*)(payload + readIdx), length - readIdx, outValue);
+			if (varintLength == 0) {
+				hasOverrun = true;
+				return false;
+			}
+			readIdx += varintLength;
+			return true;
+		}
+
+		/* Read zigzag varint from payload */
+		bool ReadSignedVarint(int64_t& outValue)
+		{
+			uint64_t value;
+			if (!ReadVarint(value))
+				return false;
+			outValue = CrossSysUtil::ZigZagDecode(value);
+			return true;
+		}
+
+		/* Read string (varint{string length} + char*{string}) from payload */
+		bool ReadVarintString(std::string& outStr)
+		{
+			uint64_t strLength;
+			uint32_t startIdx = readIdx;
+			if (!ReadVarint(strLength))
+				return false;
+			if (strLength > length - readIdx) {
+				readIdx = startIdx;
+				hasOverrun = true;
+				return false;
+			}
+			outStr.assign(payload + readIdx, (size_t)strLength);
+			readIdx += (uint32_t)strLength;
+			return true;
+		}
+
+		/* Skip over the given number of payload bytes */
+		bool Skip(uint32_t inLength)
+		{
+			return ReadSpan(inLength) != nullptr;
+		}
+
+		/* Returns the size of the remaining data in the payload in bytes */
+		uint32_t GetRemaining() const
+		{
+			return length - readIdx;
+		}
+
+		/* Returns the current read position in the payload */
+		uint32_t GetPosition() const
+		{
+			return readIdx;
+		}
+
+		/* Returns true if a read has failed due to running out of data */
+		bool HasOverrun() const
+		{
+			return hasOverrun;
+		}
+
+		/* Reset this reader so that it reads from the beginning of the payload */
+		void Reset()
+		{
+			readIdx = 0;
+			hasOverrun = false;
+		}
+
+	private:
+		const CrossPackData* payload;
+		uint32_t length;
+		uint32_t readIdx;
+		bool hasOverrun;
+
+		/* Checks that the given number of bytes can be read - marks this reader as overrun if not */
+		bool Require(uint32_t inLength)
+		{
+			if (hasOverrun || length - readIdx < inLength) {
+				hasOverrun = true;
+				return false;
+			}
+			return true;
+		}
+	};
+
+	/*
+	 * A retained reference to a packet's bytes - unlike the packet handed to a data handler, it stays
+	 * valid after the handler returns and may be passed to other threads. The bytes are freed once the
+	 * last reference is released.
+	 */
+	class CrossPackRef {
+	public:
+
+		/* Empty constructor - yields an invalid reference */
+		CrossPackRef()
+		{
+		}
+
+		/* Component constructor - the view must point into the data kept alive by the owner */
+		CrossPackRef(const std::shared_ptr<const void>& inOwner, const CrossPackView& inView)
+		{
+			owner = inOwner;
+			view = inView;
+		}
+
+		/* Returns true if this reference holds a packet */
+		bool IsValid() const
+		{
+			return owner != nullptr && view.IsValid();
+		}
+
+		/* Returns a view of the retained packet - read it with a CrossPackReader */
+		const CrossPackView& GetView() const
+		{
+			return view;
+		}
+
+		/* Releases the retained packet */
+		void Release()
+		{
+			owner.reset();
+			view = CrossPackView();
+		}
+
+	private:
+		std::shared_ptr<const void> owner;
+		CrossPackView view;
+	};
+
 	/* High level packet class - WARNING: this class automatically handles deletion of its internal buffer and must be used with caution when passed to different scopes */
 	class CrossPack {
 	public:
@@ -117,8 +519,12 @@ namespace CrossSock {
 		/* Empty constructor */
 		CrossPack()
 		{
-			payload = new CrossPackData[GetMaxPacketSize()];
+			payload = static_cast<CrossPackData*>(BufferPool::Allocate());
+			payloadCapacity = MAX_PAYLOAD_BYTES;
 			removeIdx = 0;
+			receiveTime = 0;
+			inlineBuffer = nullptr;
+			inlineCapacity = 0;
 			shouldDeleteData = true;
 			hasBeenFinalized = false;
 			hasBeenSerialized = false;
@@ -127,19 +533,48 @@ namespace CrossSock {
 		/* Copy constructor */
 		CrossPack(const CrossPack& inPack)
 		{
-			payload = new CrossPackData[GetMaxPacketSize()];
+			payload = static_cast<CrossPackData*>(BufferPool::Allocate());
+			payloadCapacity = MAX_PAYLOAD_BYTES;
 			removeIdx = 0;
+			receiveTime = 0;
+			inlineBuffer = nullptr;
+			inlineCapacity = 0;
 			shouldDeleteData = true;
 			Copy(inPack);
 		}
 
+		/* Move constructor - takes over the given packet's pooled buffer, or copies the packet if it doesn't own one. Either way the moved-from packet is left empty and can be refilled */
+		CrossPack(CrossPack&& inPack)
+		{
+			receiveTime = 0;
+			inlineBuffer = nullptr;
+			inlineCapacity = 0;
+			if (inPack.shouldDeleteData) {
+				payload = nullptr;
+				shouldDeleteData = false;
+				TakeBuffer(inPack);
+			}
+			else {
+				payload = static_cast<CrossPackData*>(BufferPool::Allocate());
+				payloadCapacity = MAX_PAYLOAD_BYTES;
+				removeIdx = 0;
+				shouldDeleteData = true;
+				Copy(inPack);
+				inPack.ClearPayload();
+			}
+		}
+
 		/* Deserialization constructor */
 		CrossPack(CrossPackData* data)
 		{
 			header = CrossPack::PeakHeader(data);
 			footer = CrossPack::PeakFooter(data, header);
 			payload = data;
+			payloadCapacity = MAX_PAYLOAD_BYTES;
 			removeIdx = 0;
+			receiveTime = 0;
+			inlineBuffer = nullptr;
+			inlineCapacity = 0;
 			shouldDeleteData = false;
 			hasBeenFinalized = false;
 			hasBeenSerialized = false;
@@ -149,8 +584,12 @@ namespace CrossSock {
 		CrossPack(CrossPackDataID inDataID)
 		{
 			header.dataID = inDataID;
-			payload = new CrossPackData[GetMaxPacketSize()];
+			payload = static_cast<CrossPackData*>(BufferPool::Allocate());
+			payloadCapacity = MAX_PAYLOAD_BYTES;
 			removeIdx = 0;
+			receiveTime = 0;
+			inlineBuffer = nullptr;
+			inlineCapacity = 0;
 			shouldDeleteData = true;
 			hasBeenFinalized = false;
 			hasBeenSerialized = false;
@@ -162,7 +601,11 @@ namespace CrossSock {
 			header = inHeader;
 			footer = inFooter;
 			payload = inPayload;
+			payloadCapacity = MAX_PAYLOAD_BYTES;
 			removeIdx = 0;
+			receiveTime = 0;
+			inlineBuffer = nullptr;
+			inlineCapacity = 0;
 			shouldDeleteData = false;
 			hasBeenFinalized = false;
 			hasBeenSerialized = false;
@@ -173,13 +616,15 @@ namespace CrossSock {
 		{
 			if (shouldDeleteData) {
 				shouldDeleteData = false;
-				delete[] payload;
+				BufferPool::Free(payload);
 			}
 		}
 
-		/* Copy an existing packet */
-		void Copy(const CrossPack& inPack)
+		/* Copy an existing packet - fails if its payload doesn't fit in this packet's capacity */
+		CrossPackError Copy(const CrossPack& inPack)
 		{
+			if (inPack.header.payloadSize > payloadCapacity)
+				return CrossPackError::INVALID_DATA_SIZE;
 			header.dataID = inPack.header.dataID;
 			header.payloadSize = inPack.header.payloadSize;
 			header.packFlags = inPack.header.packFlags;
@@ -187,38 +632,53 @@ namespace CrossSock {
 			footer.senderID = inPack.footer.senderID;
 			memcpy(payload + GetHeaderSize(), inPack.payload + GetHeaderSize(), header.payloadSize);
 			removeIdx = inPack.removeIdx;
+			receiveTime = inPack.receiveTime;
 			hasBeenFinalized = inPack.hasBeenFinalized;
 			hasBeenSerialized = false;
+			return CrossPackError::VALID_DATA;
 		}
 
-		/* Copy assignment operator */
+		/* Copy assignment operator - a packet with an inline buffer too small for the given payload takes a pooled buffer instead */
 		CrossPack& operator= (const CrossPack& inPack)
 		{
-			/* allocate memory if necessary */
-			if (!shouldDeleteData) {
-				payload = new CrossPackData[GetMaxPacketSize()];
+			if (this == &inPack)
+				return *this;
+
+			/* allocate memory if necessary - borrowed buffers are never written to */
+			bool usesInline = (inlineBuffer != nullptr && payload == inlineBuffer);
+			if (!shouldDeleteData && !(usesInline && inPack.header.payloadSize <= inlineCapacity)) {
+				payload = static_cast<CrossPackData*>(BufferPool::Allocate());
+				payloadCapacity = MAX_PAYLOAD_BYTES;
 				shouldDeleteData = true;
 			}
 
 			/* do the copy */
 			removeIdx = 0;
 			Copy(inPack);
+			return *this;
+		}
+
+		/* Move assignment operator - swaps buffers with the given packet if it owns a pooled one, or copies the packet if it doesn't. Either way the moved-from packet is left empty and can be refilled */
+		CrossPack& operator= (CrossPack&& inPack)
+		{
+			if (this == &inPack)
+				return *this;
+			if (!inPack.shouldDeleteData) {
+				*this = static_cast<const CrossPack&>(inPack);
+				inPack.ClearPayload();
+				return *this;
+			}
+			TakeBuffer(inPack);
+			return *this;
 		}
 
 		/* Utility function to peak at the packet header from raw data */
 		static CrossPackHeader PeakHeader(const CrossPackData* inData)
 		{
 			CrossPackHeader outHeader;
-			CrossPackData headerData[sizeof(CrossPackHeader)];
-			memcpy(headerData, inData, sizeof(CrossPackHeader));
-			if (!CrossSysUtil::IsLittleEndian()) {
-				CrossSysUtil::SwapEndian(headerData, 0, sizeof(CrossPackDataID));
-				CrossSysUtil::SwapEndian(headerData, sizeof(CrossPackDataID), sizeof(CrossPackPayloadLen));
-				CrossSysUtil::SwapEndian(headerData, sizeof(CrossPackDataID) + sizeof(CrossPackPayloadLen), sizeof(CrossPackFlag));
-			}
-			memcpy(&outHeader.dataID, headerData, sizeof(CrossPackDataID));
-			memcpy(&outHeader.payloadSize, headerData + sizeof(CrossPackDataID), sizeof(CrossPackPayloadLen));
-			memcpy(&outHeader.packFlags, headerData + sizeof(CrossPackDataID) + sizeof(CrossPackPayloadLen), sizeof(CrossPackFlag));
+			outHeader.dataID = CrossSysUtil::LoadLittleEndian<CrossPackDataID>(inData);
+			outHeader.payloadSize = CrossSysUtil::LoadLittleEndian<CrossPackPayloadLen>(inData + sizeof(CrossPackDataID));
+			outHeader.packFlags = inData[sizeof(CrossPackDataID) + sizeof(CrossPackPayloadLen)];
 			return outHeader;
 		}
 
@@ -233,23 +693,13 @@ namespace CrossSock {
 		static CrossPackFooter PeakFooter(const CrossPackData* inData, const CrossPackHeader& inHeader)
 		{
 			CrossPackFooter outFooter;
-			CrossPackData footerData[sizeof(CrossPackFooter)];
-			CrossPackPayloadLen footerStart = sizeof(CrossPackHeader) + inHeader.payloadSize;
-			CrossPackPayloadLen footerSize = (CrossSysUtil::CheckBit(inHeader.packFlags, CrossPackFlagBit::CHECKSUM_FLAG) ? sizeof(CrossPackChecksum) : 0)
-				+ (CrossSysUtil::CheckBit(inHeader.packFlags, CrossPackFlagBit::UDP_SUPPORT_FLAG) ? sizeof(CrossClientID) : 0);
-			memcpy(footerData, inData + footerStart, footerSize);
-			CrossPackPayloadLen offset = 0;
+			const CrossPackData* footerData = inData + sizeof(CrossPackHeader) + inHeader.payloadSize;
 			if (CrossSysUtil::CheckBit(inHeader.packFlags, CrossPackFlagBit::CHECKSUM_FLAG)) {
-				if (!CrossSysUtil::IsLittleEndian())
-					CrossSysUtil::SwapEndian(footerData, 0, sizeof(CrossPackChecksum));
-				memcpy(&outFooter.checksum, footerData, sizeof(CrossPackChecksum));
-				offset += sizeof(CrossPackChecksum);
-			}
-			if (CrossSysUtil::CheckBit(inHeader.packFlags, CrossPackFlagBit::UDP_SUPPORT_FLAG)) {
-				if (!CrossSysUtil::IsLittleEndian())
-					CrossSysUtil::SwapEndian(footerData, offset, sizeof(CrossClientID));
-				memcpy(&outFooter.senderID, footerData + offset, sizeof(CrossClientID));
+				outFooter.checksum = CrossSysUtil::LoadLittleEndian<CrossPackChecksum>(footerData);
+				footerData += sizeof(CrossPackChecksum);
 			}
+			if (CrossSysUtil::CheckBit(inHeader.packFlags, CrossPackFlagBit::UDP_SUPPORT_FLAG))
+				outFooter.senderID = CrossSysUtil::LoadLittleEndian<CrossClientID>(footerData);
 			return outFooter;
 		}
 
@@ -257,7 +707,7 @@ namespace CrossSock {
 		template<class T>
 		CrossPackError AddToPayload(T data, bool autoEndianSwap = true)
 		{
-			if (header.payloadSize + sizeof(T) > MAX_PAYLOAD_BYTES)
+			if (header.payloadSize + sizeof(T) > payloadCapacity)
 				return CrossPackError::INVALID_DATA_SIZE;
 			memcpy(payload + header.payloadSize + GetHeaderSize(), &data, sizeof(T));
 			if (autoEndianSwap && !CrossSysUtil::IsLittleEndian()) {
@@ -271,7 +721,7 @@ namespace CrossSock {
 		/* Add raw data to payload */
 		CrossPackError AddDataToPayload(const CrossPackData* inData, CrossPackPayloadLen length, bool autoEndianSwap = false)
 		{
-			if (header.payloadSize + length > MAX_PAYLOAD_BYTES)
+			if (header.payloadSize + length > payloadCapacity)
 				return CrossPackError::INVALID_DATA_SIZE;
 			memcpy(payload + header.payloadSize + GetHeaderSize(), inData, length);
 			if (autoEndianSwap && !CrossSysUtil::IsLittleEndian()) {
@@ -285,7 +735,7 @@ namespace CrossSock {
 		/* Add string (CrossPackPayloadLen{string length} + char*{string}) to payload */
 		CrossPackError AddStringToPayload(std::string inStr)
 		{
-			if (header.payloadSize + inStr.length() + sizeof(CrossPackPayloadLen) > MAX_PAYLOAD_BYTES) {
+			if (header.payloadSize + inStr.length() + sizeof(CrossPackPayloadLen) > payloadCapacity) {
 				return CrossPackError::INVALID_DATA_SIZE;
 			}
 			if (AddToPayload<CrossPackPayloadLen>((CrossPackPayloadLen)inStr.length()) != VALID_DATA) {
@@ -353,12 +803,78 @@ namespace CrossSock {
 			return "";
 		}
 
+		/* Add an unsigned value to payload as a varint - small values take fewer bytes (1 byte below 128, 2 below 16384 ...) */
+		CrossPackError AddVarintToPayload(uint64_t inValue)
+		{
+			int length = CrossSysUtil::GetVarintLength(inValue);
+			if (header.payloadSize + length > payloadCapacity)
+				return CrossPackError::INVALID_DATA_SIZE;
+			CrossSysUtil::EncodeVarint(inValue, (unsigned char*)(payload + header.payloadSize + GetHeaderSize()));
+			header.payloadSize += length;
+			hasBeenSerialized = false;
+			return CrossPackError::VALID_DATA;
+		}
+
+		/* Add a signed value to payload as a zigzag varint - values of small magnitude take fewer bytes */
+		CrossPackError AddSignedVarintToPayload(int64_t inValue)
+		{
+			return AddVarintToPayload(CrossSysUtil::ZigZagEncode(inValue));
+		}
+
+		/* Add string (varint{string length} + char*{string}) to payload */
+		CrossPackError AddVarintStringToPayload(const std::string& inStr)
+		{
+			size_t length = inStr.length();
+			if (header.payloadSize + length + CrossSysUtil::GetVarintLength(length) > payloadCapacity)
+				return CrossPackError::INVALID_DATA_SIZE;
+			AddVarintToPayload(length);
+			return AddDataToPayload(inStr.data(), (CrossPackPayloadLen)length);
+		}
+
+		/* Remove varint from payload - returns 0 if the payload ends before the varint does */
+		uint64_t RemoveVarintFromPayload() const
+		{
+			uint64_t outValue = 0;
+			int length = CrossSysUtil::DecodeVarint((const unsigned char*)(payload + GetHeaderSize() + removeIdx), header.payloadSize - removeIdx, outValue);
+			if (length == 0)
+				return 0;
+			removeIdx += length;
+			return outValue;
+		}
+
+		/* Remove zigzag varint from payload - returns 0 if the payload ends before the varint does */
+		int64_t RemoveSignedVarintFromPayload() const
+		{
+			return CrossSysUtil::ZigZagDecode(RemoveVarintFromPayload());
+		}
+
+		/* Remove string (varint{string length} + char*{string}) from payload */
+		std::string RemoveVarintStringFromPayload() const
+		{
+			CrossPackPayloadLen startIdx = removeIdx;
+			uint64_t length = RemoveVarintFromPayload();
+			uint64_t remaining = (uint64_t)(header.payloadSize - removeIdx);
+			if (removeIdx == startIdx || remaining < length) {
+				removeIdx = startIdx;
+				return "";
+			}
+			std::string outStr(payload + GetHeaderSize() + removeIdx, (size_t)length);
+			removeIdx += (CrossPackPayloadLen)length;
+			return outStr;
+		}
+
 		/* Returns this packet's payload size in bytes */
 		CrossPackPayloadLen GetPayloadSize() const
 		{
 			return header.payloadSize;
 		}
 
+		/* Returns the largest payload (in bytes) this packet can hold */
+		CrossPackPayloadLen GetPayloadCapacity() const
+		{
+			return payloadCapacity;
+		}
+
 		/* Returns the static packet header size in bytes */
 		static CrossPackPayloadLen GetHeaderSize()
 		{
@@ -451,17 +967,22 @@ namespace CrossSock {
 
 		/* Finalize this packet
 		 *
-		 *	 AddChecksum:   if true - a checksum will be added to this packet's footer
-		 *	 AddUDPSupport: if true - the given client ID will be added to this packet's footer
+		 *	 AddChecksum:    if true - a checksum will be added to this packet's footer
+		 *	 AddUDPSupport:  if true - the given client ID will be added to this packet's footer
+		 *	 inChecksumType: the checksum's algorithm - unreliable sends switch it to the connection's (see SetChecksumType)
 		 */
-		void Finalize(bool AddChecksum = true, bool AddUDPSupport = false, CrossClientID inSenderID = 0) const
+		void Finalize(bool AddChecksum = true, bool AddUDPSupport = false, CrossClientID inSenderID = 0, CrossChecksumType inChecksumType = CrossChecksumType::CHECKSUM_CRC32C) const
 		{
 			// lower finalized flag to allow for setting packet flags
 			hasBeenFinalized = false;
+			if (inChecksumType == CrossChecksumType::CHECKSUM_NONE)
+				AddChecksum = false;
 
 			// set packet flags
 			SetPacketFlag(CrossPackFlagBit::CHECKSUM_FLAG, AddChecksum);
 			SetPacketFlag(CrossPackFlagBit::UDP_SUPPORT_FLAG, AddUDPSupport);
+			header.packFlags = CrossSysUtil::SetStateToFlag<CrossPackFlag>(header.packFlags, AddChecksum ? (CrossPackFlag)inChecksumType : 0,
+				CrossPackFlagBit::CHECKSUM_TYPE_FLAG_1, CrossPackFlagBit::CHECKSUM_TYPE_FLAG_2);
 
 			// set footer data
 			if (AddUDPSupport)
@@ -474,24 +995,82 @@ namespace CrossSock {
 			hasBeenSerialized = false;
 		}
 
-		/* Calculate this packet's checksum */
+		/* Calculate this packet's checksum with the algorithm given by its header flags */
 		CrossPackChecksum CalculateChecksum() const
 		{
+			return CalculateChecksum(header, footer.senderID, payload + GetHeaderSize());
+		}
+
+		/* Calculate the checksum of a packet from its header, sender ID and payload with the algorithm given by the header flags */
+		static CrossPackChecksum CalculateChecksum(const CrossPackHeader& inHeader, CrossClientID inSenderID, const CrossPackData* inPayload)
+		{
+			CrossChecksumType checksumType = GetChecksumType(inHeader);
+			if (checksumType == CrossChecksumType::CHECKSUM_CRC32C || checksumType == CrossChecksumType::CHECKSUM_XXHASH32) {
+
+				/* the header fields and sender ID are hashed in little endian order */
+				unsigned char fields[9];
+				fields[0] = (unsigned char)(inHeader.dataID & 0xFF);
+				fields[1] = (unsigned char)(inHeader.dataID >> 8);
+				fields[2] = (unsigned char)(inHeader.payloadSize & 0xFF);
+				fields[3] = (unsigned char)(inHeader.payloadSize >> 8);
+				fields[4] = (unsigned char)inHeader.packFlags;
+				for (int b = 0; b < 4; b++)
+					fields[5 + b] = (unsigned char)(inSenderID >> (8 * b));
+
+				if (checksumType == CrossChecksumType::CHECKSUM_CRC32C) {
+					uint32_t crc = CrossChecksum::Crc32c(0, fields, 5);
+					crc = CrossChecksum::Crc32c(crc, inPayload, inHeader.payloadSize);
+					return (CrossPackChecksum)CrossChecksum::Crc32c(crc, fields + 5, 4);
+				}
+
+				/* the payload hash is hashed again with the fields */
+				uint32_t payloadHash = CrossChecksum::XXHash32(inPayload, inHeader.payloadSize);
+				unsigned char block[13];
+				for (int b = 0; b < 4; b++)
+					block[b] = (unsigned char)(payloadHash >> (8 * b));
+				memcpy(block + 4, fields, sizeof(fields));
+				return (CrossPackChecksum)CrossChecksum::XXHash32(block, sizeof(block));
+			}
+
 			CrossPackChecksum outChecksum = 0;
-			for (int x = 0; x < header.payloadSize; x++) {
-				outChecksum += payload[x + GetHeaderSize()];
+			for (int x = 0; x < inHeader.payloadSize; x++) {
+				outChecksum += inPayload[x];
 			}
-			outChecksum += header.dataID;
-			outChecksum += header.payloadSize;
-			outChecksum += header.packFlags;
-			outChecksum += footer.senderID;
+			outChecksum += inHeader.dataID;
+			outChecksum += inHeader.payloadSize;
+			outChecksum += inHeader.packFlags;
+			outChecksum += inSenderID;
 			return outChecksum;
 		}
 
+		/* Utility function that returns the algorithm of a packet's checksum from its header flags */
+		static CrossChecksumType GetChecksumType(const CrossPackHeader& inHeader)
+		{
+			if (!CrossSysUtil::CheckBit(inHeader.packFlags, CrossPackFlagBit::CHECKSUM_FLAG))
+				return CrossChecksumType::CHECKSUM_NONE;
+			return (CrossChecksumType)CrossSysUtil::GetStateFromFlag<CrossPackFlag>(inHeader.packFlags, CrossPackFlagBit::CHECKSUM_TYPE_FLAG_1, CrossPackFlagBit::CHECKSUM_TYPE_FLAG_2);
+		}
+
+		/* Get the algorithm of this packet's checksum */
+		CrossChecksumType GetChecksumType() const
+		{
+			return GetChecksumType(header);
+		}
+
+		/*
+		 * Refinalizes this packet with the given checksum algorithm if it was finalized with a checksum of another.
+		 * Packets are left as they are for CHECKSUM_NONE, as peers that use it can check any algorithm
+		 */
+		void SetChecksumType(CrossChecksumType inChecksumType) const
+		{
+			if (hasBeenFinalized && inChecksumType != CrossChecksumType::CHECKSUM_NONE && GetPacketFlag(CrossPackFlagBit::CHECKSUM_FLAG) && GetChecksumType() != inChecksumType)
+				Finalize(true, GetPacketFlag(CrossPackFlagBit::UDP_SUPPORT_FLAG), footer.senderID, inChecksumType);
+		}
+
 		/* Set one of this packet's given flag's to the given value. NOTE: non-custom flags should not be set manually, and might be unavailable after packet finalization */
 		CrossPackError SetPacketFlag(const CrossPackFlagBit& inFlag, bool inValue) const
 		{
-			if (hasBeenFinalized && inFlag < CrossPackFlagBit::CUSTOM_FLAG_1) 
+			if (hasBeenFinalized && (inFlag < CrossPackFlagBit::CUSTOM_FLAG_1 || inFlag >= CrossPackFlagBit::CHECKSUM_TYPE_FLAG_1))
 				return CrossPackError::HAS_BEEN_FINALIZED;
 			if (inValue)
 				header.packFlags = CrossSysUtil::SetBit(header.packFlags, inFlag);
@@ -510,7 +1089,7 @@ namespace CrossSock {
 		/* Set one of this packet's states to the given value. NOTE: an error will be returned if used on non-custom packet flag bits after packet finalization */
 		CrossPackError SetPacketState(const CrossPackFlagBit& inStart, const CrossPackFlagBit& inEnd, CrossPackFlag inValue)
 		{
-			if (hasBeenFinalized && inStart < CrossPackFlagBit::CUSTOM_FLAG_1)
+			if (hasBeenFinalized && (inStart < CrossPackFlagBit::CUSTOM_FLAG_1 || inEnd >= CrossPackFlagBit::CHECKSUM_TYPE_FLAG_1))
 				return CrossPackError::HAS_BEEN_FINALIZED;
 			header.packFlags = CrossSysUtil::SetStateToFlag(header.packFlags, inValue, inStart, inEnd);
 			hasBeenSerialized = false;
@@ -543,6 +1122,41 @@ namespace CrossSock {
 			return footer.checksum;
 		}
 
+		/* Returns a read-only view of this packet that doesn't require serialization - the view is invalidated once this packet is altered or destroyed */
+		CrossPackView GetView() const
+		{
+			return CrossPackView(header, footer, payload + GetHeaderSize(), receiveTime);
+		}
+
+		/*
+		 * Gets the kernel receive time of this packet in nanoseconds since the epoch - 0 if it wasn't recorded.
+		 * Compare it with CrossSysUtil::GetSystemTimeNS() to find how long the packet waited to be handled. A TCP
+		 * packet carries the time of the newest segment in the read that completed it, so a packet split across
+		 * reads is stamped when its last bytes arrived
+		 */
+		int64_t GetReceiveTime() const
+		{
+			return receiveTime;
+		}
+
+		/* Sets the kernel receive time of this packet */
+		void SetReceiveTime(int64_t inReceiveTime)
+		{
+			receiveTime = inReceiveTime;
+		}
+
+		/*
+		 * Returns a reference to this packet that stays valid after the data handler returns - the payload is
+		 * copied into a pooled block, which holds the reference count too, so a retain makes a single allocation
+		 * that is usually recycled rather than taken from the heap
+		 */
+		CrossPackRef Retain() const
+		{
+			std::shared_ptr<RetainedPayload> copy = std::allocate_shared<RetainedPayload>(CrossPoolAllocator<RetainedPayload>());
+			memcpy(copy->data, payload + GetHeaderSize(), header.payloadSize);
+			return CrossPackRef(copy, CrossPackView(header, footer, copy->data, receiveTime));
+		}
+
 		/* Reset this packet so that it removes data from it's beginning - if you would like to clear the packet, use ClearPayload */
 		void Reset() const
 		{
@@ -552,17 +1166,717 @@ namespace CrossSock {
 		/* The maximum payload size */
 		static const unsigned int MAX_PAYLOAD_BYTES = 1500 - sizeof(CrossPackHeader) - sizeof(CrossPackFooter);
 
+		/* The pool every packet buffer is taken from - see CrossBlockPool */
+		typedef CrossBlockPool<sizeof(CrossPackHeader) + MAX_PAYLOAD_BYTES + sizeof(CrossPackFooter)> BufferPool;
+
+	protected:
+
+		/* Inline buffer constructor - the buffer must hold the header, the given payload capacity, and the footer, and outlive this packet */
+		CrossPack(CrossPackData* inBuffer, CrossPackPayloadLen inCapacity, CrossPackDataID inDataID)
+		{
+			header.dataID = inDataID;
+			payload = inBuffer;
+			payloadCapacity = inCapacity;
+			removeIdx = 0;
+			receiveTime = 0;
+			inlineBuffer = inBuffer;
+			inlineCapacity = inCapacity;
+			shouldDeleteData = false;
+			hasBeenFinalized = false;
+			hasBeenSerialized = false;
+		}
+
 	private:
+
+		/* A retained copy of a payload - left uninitialized, as only the copied bytes are read */
+		struct RetainedPayload {
+			CrossPackData data[MAX_PAYLOAD_BYTES];
+
+			RetainedPayload() {}
+		};
+
+		/* Takes over the given packet's buffer and hands it this packet's pooled buffer, if any - the given packet must own its buffer */
+		void TakeBuffer(CrossPack& inPack)
+		{
+			CrossPackData* spareBuffer = shouldDeleteData ? payload : nullptr;
+			header = inPack.header;
+			footer = inPack.footer;
+			payload = inPack.payload;
+			payloadCapacity = inPack.payloadCapacity;
+			removeIdx = inPack.removeIdx;
+			receiveTime = inPack.receiveTime;
+			shouldDeleteData = true;
+			hasBeenFinalized = inPack.hasBeenFinalized;
+			hasBeenSerialized = inPack.hasBeenSerialized;
+
+			/* leave the given packet empty and usable - with its inline buffer if it has one, and a pooled buffer otherwise */
+			inPack.header.payloadSize = 0;
+			if (inPack.inlineBuffer != nullptr) {
+				if (spareBuffer != nullptr)
+					BufferPool::Free(spareBuffer);
+				inPack.payload = inPack.inlineBuffer;
+				inPack.payloadCapacity = inPack.inlineCapacity;
+				inPack.shouldDeleteData = false;
+			}
+			else {
+				inPack.payload = (spareBuffer != nullptr) ? spareBuffer : static_cast<CrossPackData*>(BufferPool::Allocate());
+				inPack.payloadCapacity = MAX_PAYLOAD_BYTES;
+				inPack.shouldDeleteData = true;
+			}
+			inPack.removeIdx = 0;
+			inPack.hasBeenFinalized = false;
+			inPack.hasBeenSerialized = false;
+		}
+
 		mutable CrossPackHeader header;
 		mutable CrossPackFooter footer;
 		CrossPackData* payload;
+		CrossPackPayloadLen payloadCapacity;
 		mutable CrossPackPayloadLen removeIdx;
+		int64_t receiveTime;
+		CrossPackData* inlineBuffer;
+		CrossPackPayloadLen inlineCapacity;
 		bool shouldDeleteData;
 		mutable bool hasBeenFinalized;
 		mutable bool hasBeenSerialized;
 	};
 
 	typedef std::shared_ptr<CrossPack> CrossPackPtr;
+
+	/* Returns a packet allocated by CrossPackPool::AcquireUnique to its pool */
+	struct CrossPackDeleter {
+		void operator()(CrossPack* inPack) const
+		{
+			inPack->~CrossPack();
+			CrossPoolAllocator<CrossPack>().deallocate(inPack, 1);
+		}
+	};
+
+	typedef std::unique_ptr<CrossPack, CrossPackDeleter> CrossPackUniquePtr;
+
+	/*
+	 * Packet that holds up to Capacity payload bytes in an inline buffer instead of a pooled one - a small
+	 * packet on the stack needs no allocation at all. It can be passed to every API that takes a CrossPack.
+	 */
+	template <unsigned int Capacity>
+	class CrossPackT : public CrossPack {
+	public:
+
+		/* Component constructor */
+		CrossPackT(CrossPackDataID inDataID = StaticDataID::UNKNOWN_PACK) : CrossPack(inlineData, Capacity, inDataID)
+		{
+		}
+
+		/* Copy constructor */
+		CrossPackT(const CrossPackT& inPack) : CrossPack(inlineData, Capacity, StaticDataID::UNKNOWN_PACK)
+		{
+			CrossPack::operator=(inPack);
+		}
+
+		/* Conversion constructor - a payload that doesn't fit the inline buffer is held in a pooled buffer instead */
+		explicit CrossPackT(const CrossPack& inPack) : CrossPack(inlineData, Capacity, StaticDataID::UNKNOWN_PACK)
+		{
+			CrossPack::operator=(inPack);
+		}
+
+		/* Copy assignment operator - a payload that doesn't fit the inline buffer is held in a pooled buffer instead */
+		CrossPackT& operator= (const CrossPackT& inPack)
+		{
+			CrossPack::operator=(inPack);
+			return *this;
+		}
+
+		static_assert(Capacity <= CrossPack::MAX_PAYLOAD_BYTES, "CrossPackT capacity exceeds the maximum payload size");
+
+	private:
+		CrossPackData inlineData[sizeof(CrossPackHeader) + Capacity + sizeof(CrossPackFooter)];
+	};
+
+	/*
+	 * Shared packets whose memory comes from pools - both the packet buffer and the shared pointer's
+	 * packet and control block are reused, so a steady flow of packets does no heap allocation.
+	 * Packets may be released on any thread.
+	 */
+	class CrossPackPool {
+	public:
+
+		/* Takes a packet with the given data ID from the pool */
+		static CrossPackPtr Acquire(CrossPackDataID inDataID = StaticDataID::UNKNOWN_PACK)
+		{
+			return std::allocate_shared<CrossPack>(CrossPoolAllocator<CrossPack>(), inDataID);
+		}
+
+		/* Takes a copy of the given packet from the pool */
+		static CrossPackPtr Acquire(const CrossPack& inPack)
+		{
+			return std::allocate_shared<CrossPack>(CrossPoolAllocator<CrossPack>(), inPack);
+		}
+
+		/* Moves the given packet into a packet from the pool - its buffer is taken over rather than copied if it owns one */
+		static CrossPackPtr Acquire(CrossPack&& inPack)
+		{
+			return std::allocate_shared<CrossPack>(CrossPoolAllocator<CrossPack>(), std::move(inPack));
+		}
+
+		/* Takes a packet with the given data ID from the pool, owned by a single holder */
+		static CrossPackUniquePtr AcquireUnique(CrossPackDataID inDataID = StaticDataID::UNKNOWN_PACK)
+		{
+			CrossPack* pack = CrossPoolAllocator<CrossPack>().allocate(1);
+			return CrossPackUniquePtr(new (pack) CrossPack(inDataID));
+		}
+	};
+
+	/*
+	 * Writes values of any bit width (1 to 64 bits) to the end of a packet's payload - bits are collected in
+	 * a 64 bit scratch word, low bits first, and each full word is added with a single store. Call Flush once
+	 * done (or let the writer go out of scope) before adding anything else to the payload.
+	 */
+	class CrossBitWriter {
+	public:
+
+		/* Packet constructor */
+		CrossBitWriter(CrossPack& inPack)
+		{
+			pack = &inPack;
+			scratch = 0;
+			scratchBits = 0;
+			bitsWritten = 0;
+			hasOverflowed = false;
+		}
+
+		/* Destructor - flushes the remaining bits */
+		~CrossBitWriter()
+		{
+			Flush();
+		}
+
+		/* Write the low bits of a value - returns false if the payload is full, or the number of bits isn't 1 to 64 */
+		bool Write(uint64_t inValue, int inBits)
+		{
+			if (hasOverflowed || inBits < 1 || inBits > 64)
+				return false;
+			if (inBits < 64)
+				inValue &= (1ULL << inBits) - 1;
+			scratch |= inValue << scratchBits;
+			int totalBits = scratchBits + inBits;
+			if (totalBits >= 64) {
+				if (pack->AddToPayload<uint64_t>(scratch) != CrossPackError::VALID_DATA) {
+					hasOverflowed = true;
+					return false;
+				}
+				scratch = (scratchBits == 0) ? 0 : inValue >> (64 - scratchBits);
+				totalBits -= 64;
+			}
+			scratchBits = totalBits;
+			bitsWritten += inBits;
+			return true;
+		}
+
+		/* Write a boolean as a single bit */
+		bool WriteBool(bool inValue)
+		{
+			return Write(inValue ? 1 : 0, 1);
+		}
+
+		/*
+		 * Write a value in the range [inMin, inMax] quantized to the given number of bits (1 to 32) - values outside
+		 * the range are clamped. Steps are computed in double, as a float can't tell apart every step above 24 bits
+		 */
+		bool WriteQuantized(float inValue, float inMin, float inMax, int inBits)
+		{
+			if (inBits < 1 || inBits > 32)
+				return false;
+			double maxStep = (double)((1ULL << inBits) - 1);
+			double unit = ((double)inValue - inMin) / ((double)inMax - inMin);
+			if (!(unit > 0.0))
+				unit = 0.0;
+			else if (unit > 1.0)
+				unit = 1.0;
+			double step = unit * maxStep + 0.5;
+			return Write((uint64_t)(step < maxStep ? step : maxStep), inBits);
+		}
+
+		/* Add the remaining bits to the payload, padded to a whole byte - returns false if they didn't fit */
+		bool Flush()
+		{
+			if (hasOverflowed)
+				return false;
+			if (scratchBits > 0) {
+				CrossPackData bytes[sizeof(uint64_t)];
+				int numBytes = (scratchBits + 7) / 8;
+				for (int b = 0; b < numBytes; b++)
+					bytes[b] = (CrossPackData)(scratch >> (8 * b));
+				if (pack->AddDataToPayload(bytes, (CrossPackPayloadLen)numBytes) != CrossPackError::VALID_DATA) {
+					hasOverflowed = true;
+					return false;
+				}
+				bitsWritten += 8 * numBytes - scratchBits;
+				scratch = 0;
+				scratchBits = 0;
+			}
+			return true;
+		}
+
+		/* Returns the number of bits written, including the padding of flushes */
+		size_t GetBitsWritten() const
+		{
+			return bitsWritten;
+		}
+
+		/* Returns true if a write has failed due to the payload being full */
+		bool HasOverflowed() const
+		{
+			return hasOverflowed;
+		}
+
+	private:
+		CrossPack* pack;
+		uint64_t scratch;
+		int scratchBits;
+		size_t bitsWritten;
+		bool hasOverflowed;
+	};
+
+	/*
+	 * Read cursor for values written by a CrossBitWriter - the payload is loaded into a 64 bit scratch word up
+	 * to 8 bytes at a time. Once a read fails the reader is marked as overrun and all further reads fail
+	 */
+	class CrossBitReader {
+	public:
+
+		/* View constructor - reading starts at the given payload byte (see CrossPackReader::GetPosition) */
+		CrossBitReader(const CrossPackView& inView, uint32_t inBytePosition = 0)
+		{
+			payload = inView.GetPayload();
+			length = inView.IsValid() ? inView.GetPayloadSize() : 0;
+			bytePosition = inBytePosition < length ? inBytePosition : length;
+			scratch = 0;
+			scratchBits = 0;
+			hasOverrun = false;
+		}
+
+		/* Read a value of the given number of bits (1 to 64) - returns false if there aren't enough bits left */
+		bool Read(uint64_t& outValue, int inBits)
+		{
+			if (inBits < 1 || inBits > 64) {
+				hasOverrun = true;
+				return false;
+			}
+			if (inBits > 32) {
+				uint64_t low, high;
+				if (!Read(low, 32) || !Read(high, inBits - 32))
+					return false;
+				outValue = low | (high << 32);
+				return true;
+			}
+			if (scratchBits < inBits) {
+				Refill();
+				if (hasOverrun || scratchBits < inBits) {
+					hasOverrun = true;
+					return false;
+				}
+			}
+			outValue = scratch & ((1ULL << inBits) - 1);
+			scratch >>= inBits;
+			scratchBits -= inBits;
+			return true;
+		}
+
+		/* Read a value of the given number of bits - returns 0 and marks this reader as overrun if there aren't enough bits left */
+		template<class T>
+		T Read(int inBits)
+		{
+			uint64_t outValue = 0;
+			Read(outValue, inBits);
+			return (T)outValue;
+		}
+
+		/* Read a single bit boolean */
+		bool ReadBool()
+		{
+			return Read<uint64_t>(1) != 0;
+		}
+
+		/* Read a value written by CrossBitWriter::WriteQuantized with the same range and number of bits (1 to 32) */
+		float ReadQuantized(float inMin, float inMax, int inBits)
+		{
+			if (inBits < 1 || inBits > 32) {
+				hasOverrun = true;
+				return inMin;
+			}
+			double maxStep = (double)((1ULL << inBits) - 1);
+			return (float)(inMin + ((double)inMax - inMin) * (Read<uint32_t>(inBits) / maxStep));
+		}
+
+		/* Skip to the next whole byte - the padding of CrossBitWriter::Flush */
+		void AlignToByte()
+		{
+			scratch >>= scratchBits % 8;
+			scratchBits -= scratchBits % 8;
+		}
+
+		/* Returns the payload byte after the last byte read from - where byte reads can continue once aligned */
+		uint32_t GetBytePosition() const
+		{
+			return bytePosition - scratchBits / 8;
+		}
+
+		/* Returns true if a read has failed due to running out of data */
+		bool HasOverrun() const
+		{
+			return hasOverrun;
+		}
+
+	private:
+		const CrossPackData* payload;
+		uint32_t length;
+		uint32_t bytePosition;
+		uint64_t scratch;
+		int scratchBits;
+		bool hasOverrun;
+
+		/* Loads as many whole bytes as fit into the scratch word */
+		void Refill()
+		{
+			if (hasOverrun)
+				return;
+			if (length - bytePosition >= sizeof(uint64_t)) {
+				uint64_t word = CrossSysUtil::LoadLittleEndian<uint64_t>(payload + bytePosition);
+				int numBytes = (63 - scratchBits) / 8;
+				scratch |= word << scratchBits;
+				scratchBits += 8 * numBytes;
+				bytePosition += numBytes;
+				if (numBytes < 8)
+					scratch &= (1ULL << scratchBits) - 1;
+			}
+			else {
+				while (scratchBits <= 56 && bytePosition < length) {
+					scratch |= (uint64_t)(unsigned char)payload[bytePosition] << scratchBits;
+					scratchBits += 8;
+					bytePosition++;
+				}
+			}
+		}
+	};
+
+	/*
+	 * Reusable buffers for messages that are sent or received in fragments - buffers keep their
+	 * memory between messages, and up to a fixed number of free buffers are kept for reuse
+	 */
+	class CrossMessageBufferPool {
+	public:
+		CrossMessageBufferPool(size_t inMaxFreeBuffers = 16)
+		{
+			maxFreeBuffers = inMaxFreeBuffers;
+		}
+
+		/* Fills the given (empty) buffer with one from the pool, resized to the given number of bytes */
+		void Acquire(std::vector<CrossPackData>& outBuffer, size_t inSize)
+		{
+			if (!freeBuffers.empty()) {
+				outBuffer.swap(freeBuffers.back());
+				freeBuffers.pop_back();
+			}
+			outBuffer.resize(inSize);
+		}
+
+		/* Returns a buffer to the pool - the given buffer is left empty */
+		void Release(std::vector<CrossPackData>& inBuffer)
+		{
+			if (freeBuffers.size() < maxFreeBuffers && inBuffer.capacity() > 0)
+				freeBuffers.push_back(std::move(inBuffer));
+			std::vector<CrossPackData>().swap(inBuffer);
+		}
+
+		/* Gets the number of free buffers held by the pool */
+		size_t GetNumFreeBuffers() const
+		{
+			return freeBuffers.size();
+		}
+
+	private:
+		std::vector<std::vector<CrossPackData>> freeBuffers;
+		size_t maxFreeBuffers;
+	};
+
+	/* A message waiting to be sent in fragments */
+	struct CrossOutboundMessage
+	{
+		std::vector<CrossPackData> data;
+		CrossPackDataID dataID;
+		uint32_t messageID;
+		uint32_t nextFragment;
+		NetTransMethod method;
+	};
+
+	/*
+	 * Splits messages too large for a single packet into FRAGMENT_PACK packets - each fragment holds
+	 * (CrossPackDataID{message data ID} + uint32_t{message ID} + uint32_t{message size} + uint32_t{fragment index})
+	 * followed by up to FRAGMENT_DATA_BYTES of the message. Queued messages take turns fragment by fragment,
+	 * so one large message doesn't hold back the others.
+	 */
+	class CrossFragmenter {
+	public:
+		CrossFragmenter()
+		{
+			nextMessageID = 0;
+			queuedBytes = 0;
+		}
+
+		/* Queues a message to be sent in fragments - its data is copied into a buffer from the pool */
+		void Queue(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize, NetTransMethod inMethod, CrossMessageBufferPool& inPool)
+		{
+			messages.push_back(CrossOutboundMessage());
+			CrossOutboundMessage& message = messages.back();
+			inPool.Acquire(message.data, inSize);
+			memcpy(message.data.data(), inData, inSize);
+			message.dataID = inDataID;
+			message.messageID = nextMessageID++;
+			message.nextFragment = 0;
+			message.method = inMethod;
+			queuedBytes += inSize;
+		}
+
+		/*
+		 * Writes the next fragment to send into the given packet, along with its message's data ID - returns false
+		 * if no message is queued. The fragment stays next until PopFragment, so it can be retried if not sent
+		 */
+		bool NextFragment(CrossPack& outPack, CrossPackDataID& outDataID, NetTransMethod& outMethod) const
+		{
+			if (messages.empty())
+				return false;
+
+			const CrossOutboundMessage& message = messages.front();
+			uint32_t messageSize = (uint32_t)message.data.size();
+			uint32_t offset = message.nextFragment * FRAGMENT_DATA_BYTES;
+			uint32_t fragmentSize = (messageSize - offset < FRAGMENT_DATA_BYTES) ? messageSize - offset : FRAGMENT_DATA_BYTES;
+			outPack.ClearPayload();
+			outPack.SetDataID(StaticDataID::FRAGMENT_PACK);
+			outPack.AddToPayload<CrossPackDataID>(message.dataID);
+			outPack.AddToPayload<uint32_t>(message.messageID);
+			outPack.AddToPayload<uint32_t>(messageSize);
+			outPack.AddToPayload<uint32_t>(message.nextFragment);
+			outPack.AddDataToPayload(message.data.data() + offset, (CrossPackPayloadLen)fragmentSize);
+			outDataID = message.dataID;
+			outMethod = message.method;
+			return true;
+		}
+
+		/* Moves past the fragment written by NextFragment once it has been sent */
+		void PopFragment(CrossMessageBufferPool& inPool)
+		{
+			if (messages.empty())
+				return;
+
+			CrossOutboundMessage& message = messages.front();
+			uint32_t messageSize = (uint32_t)message.data.size();
+			uint32_t offset = message.nextFragment * FRAGMENT_DATA_BYTES;
+			uint32_t fragmentSize = (messageSize - offset < FRAGMENT_DATA_BYTES) ? messageSize - offset : FRAGMENT_DATA_BYTES;
+			queuedBytes -= fragmentSize;
+			message.nextFragment++;
+
+			/* finished messages leave the queue - others go to its back */
+			if (offset + fragmentSize >= messageSize) {
+				inPool.Release(message.data);
+				messages.pop_front();
+			}
+			else if (messages.size() > 1) {
+				messages.push_back(std::move(message));
+				messages.pop_front();
+			}
+		}
+
+		/* Drops every queued message */
+		void Clear(CrossMessageBufferPool& inPool)
+		{
+			for (size_t m = 0; m < messages.size(); m++)
+				inPool.Release(messages[m].data);
+			messages.clear();
+			queuedBytes = 0;
+		}
+
+		/* Gets the number of messages waiting to be sent */
+		size_t GetNumMessages() const
+		{
+			return messages.size();
+		}
+
+		/* Gets the number of message bytes waiting to be sent */
+		size_t GetQueuedBytes() const
+		{
+			return queuedBytes;
+		}
+
+		/* The size of the fields that start each fragment's payload */
+		static const uint32_t FRAGMENT_HEADER_BYTES = sizeof(CrossPackDataID) + 3 * sizeof(uint32_t);
+
+		/* The number of message bytes held by each fragment but the last */
+		static const uint32_t FRAGMENT_DATA_BYTES = CrossPack::MAX_PAYLOAD_BYTES - FRAGMENT_HEADER_BYTES;
+
+	private:
+		std::deque<CrossOutboundMessage> messages;
+		uint32_t nextMessageID;
+		size_t queuedBytes;
+	};
+
+	enum CrossFragmentResult
+	{
+		/* The fragment was stored (or had been already) - its message still needs more fragments */
+		FRAGMENT_PENDING = 0,
+
+		/* The fragment finished its message */
+		FRAGMENT_COMPLETE = 1,
+
+		/* The fragment was malformed, or its message is too large or doesn't fit in the memory limit */
+		FRAGMENT_REJECTED = 2
+	};
+
+	/* A message being reassembled from fragments */
+	struct CrossInboundMessage
+	{
+		std::vector<CrossPackData> data;
+		std::vector<bool> receivedFragments;
+		uint32_t numReceived;
+		CrossPackDataID dataID;
+		double lastFragmentTime;
+	};
+
+	/*
+	 * Reassembles the messages split by a CrossFragmenter into contiguous buffers - fragments may arrive
+	 * in any order and more than once (over UDP), and the fragments of several messages may interleave.
+	 * The IDs of recently finished messages are kept, so that late copies of their fragments are ignored
+	 */
+	class CrossReassembler {
+	public:
+		CrossReassembler()
+		{
+			bufferedBytes = 0;
+			nextFinishedID = 0;
+		}
+
+		/*
+		 * Adds a received fragment. When it finishes its message, the message's data is swapped into outData
+		 * (to be returned to the pool once handled). Messages over inMaxMessageBytes, or that would take the
+		 * bytes held for unfinished messages over inMaxBufferedBytes, are rejected.
+		 */
+		CrossFragmentResult AddFragment(const CrossPack& inPack, double inTime, uint32_t inMaxMessageBytes, size_t inMaxBufferedBytes, CrossMessageBufferPool& inPool, CrossPackDataID& outDataID, std::vector<CrossPackData>& outData)
+		{
+			CrossPackReader reader(inPack.GetView());
+			CrossPackDataID dataID;
+			uint32_t messageID, messageSize, fragmentIndex;
+			if (!reader.Read(dataID) || !reader.Read(messageID) || !reader.Read(messageSize) || !reader.Read(fragmentIndex))
+				return CrossFragmentResult::FRAGMENT_REJECTED;
+			if (dataID < StaticDataID::CUSTOM_DATA_START || messageSize == 0 || messageSize > inMaxMessageBytes)
+				return CrossFragmentResult::FRAGMENT_REJECTED;
+
+			/* the fragment must hold exactly its share of the message */
+			uint32_t numFragments = (messageSize + CrossFragmenter::FRAGMENT_DATA_BYTES - 1) / CrossFragmenter::FRAGMENT_DATA_BYTES;
+			if (fragmentIndex >= numFragments)
+				return CrossFragmentResult::FRAGMENT_REJECTED;
+			uint32_t offset = fragmentIndex * CrossFragmenter::FRAGMENT_DATA_BYTES;
+			uint32_t fragmentSize = (messageSize - offset < CrossFragmenter::FRAGMENT_DATA_BYTES) ? messageSize - offset : CrossFragmenter::FRAGMENT_DATA_BYTES;
+			if (reader.GetRemaining() != fragmentSize)
+				return CrossFragmentResult::FRAGMENT_REJECTED;
+
+			/* start a new message if this is its first fragment to arrive */
+			auto it = messages.find(messageID);
+			if (it == messages.end()) {
+				if (IsFinished(messageID))
+					return CrossFragmentResult::FRAGMENT_PENDING;
+				if (bufferedBytes + messageSize > inMaxBufferedBytes)
+					return CrossFragmentResult::FRAGMENT_REJECTED;
+				it = messages.insert(std::make_pair(messageID, CrossInboundMessage())).first;
+				inPool.Acquire(it->second.data, messageSize);
+				it->second.receivedFragments.assign(numFragments, false);
+				it->second.numReceived = 0;
+				it->second.dataID = dataID;
+				bufferedBytes += messageSize;
+			}
+			CrossInboundMessage& message = it->second;
+			if (message.dataID != dataID || message.data.size() != messageSize)
+				return CrossFragmentResult::FRAGMENT_REJECTED;
+			message.lastFragmentTime = inTime;
+			if (message.receivedFragments[fragmentIndex])
+				return CrossFragmentResult::FRAGMENT_PENDING;
+
+			memcpy(message.data.data() + offset, reader.ReadSpan(fragmentSize), fragmentSize);
+			message.receivedFragments[fragmentIndex] = true;
+			message.numReceived++;
+			if (message.numReceived < numFragments)
+				return CrossFragmentResult::FRAGMENT_PENDING;
+
+			/* hand over the finished message */
+			outDataID = dataID;
+			outData.swap(message.data);
+			bufferedBytes -= messageSize;
+			messages.erase(it);
+			AddFinished(messageID);
+			return CrossFragmentResult::FRAGMENT_COMPLETE;
+		}
+
+		/* Drops unfinished messages that haven't received a fragment since the given time */
+		void DropStaleMessages(double inOldestTime, CrossMessageBufferPool& inPool)
+		{
+			auto it = messages.begin();
+			while (it != messages.end()) {
+				if (it->second.lastFragmentTime < inOldestTime) {
+					bufferedBytes -= it->second.data.size();
+					inPool.Release(it->second.data);
+					AddFinished(it->first);
+					it = messages.erase(it);
+				}
+				else {
+					it++;
+				}
+			}
+		}
+
+		/* Drops every unfinished message, and forgets the finished ones - message IDs start over with a new connection */
+		void Clear(CrossMessageBufferPool& inPool)
+		{
+			DropStaleMessages(std::numeric_limits<double>::infinity(), inPool);
+			finishedIDs.clear();
+			nextFinishedID = 0;
+		}
+
+		/* Gets the number of unfinished messages */
+		size_t GetNumMessages() const
+		{
+			return messages.size();
+		}
+
+		/* Gets the number of bytes held for unfinished messages */
+		size_t GetBufferedBytes() const
+		{
+			return bufferedBytes;
+		}
+
+		/* The number of finished (or dropped) message IDs kept to ignore late fragments */
+		static const size_t MAX_FINISHED_IDS = 256;
+
+	private:
+		std::unordered_map<uint32_t, CrossInboundMessage> messages;
+		size_t bufferedBytes;
+		std::vector<uint32_t> finishedIDs;
+		size_t nextFinishedID;
+
+		/* Remembers a finished message's ID, replacing the oldest once full */
+		void AddFinished(uint32_t inMessageID)
+		{
+			if (finishedIDs.size() < MAX_FINISHED_IDS) {
+				finishedIDs.push_back(inMessageID);
+				return;
+			}
+			finishedIDs[nextFinishedID] = inMessageID;
+			nextFinishedID = (nextFinishedID + 1) % MAX_FINISHED_IDS;
+		}
+
+		/* Returns true if the message with the given ID finished recently - false otherwise */
+		bool IsFinished(uint32_t inMessageID) const
+		{
+			return std::find(finishedIDs.begin(), finishedIDs.end(), inMessageID) != finishedIDs.end();
+		}
+	};
 }
 
 #endif
\ No newline at end of file
@@ -22,6 +22,8 @@
 #include "CrossSock.h"
 #include "CrossPack.h"
 #include <unordered_map>
+#include <list>
+#include <climits>
 
 
 namespace CrossSock {
@@ -41,6 +43,173 @@ namespace CrossSock {
 		CLIENT_ENTRY_DISCONNECTED = 3
 	};
 
+	enum CrossShapingPolicy
+	{
+		/* Packets over their bandwidth budget are queued and sent once the budget allows */
+		SHAPING_QUEUE = 0,
+
+		/* Packets over their bandwidth budget are dropped */
+		SHAPING_DROP = 1
+	};
+
+	/* Bandwidth limit of a single data type */
+	struct CrossDataShaping
+	{
+		double bytesPerSecond;
+		double burstBytes;
+		CrossShapingPolicy policy;
+	};
+
+	enum CrossFilterSender
+	{
+		/* Every sender */
+		FILTER_ANY_SENDER = 0,
+
+		/* Senders that aren't connected clients */
+		FILTER_UNKNOWN_SENDER = 1,
+
+		/* Connected clients */
+		FILTER_KNOWN_SENDER = 2
+	};
+
+	/*
+	 * A rule of the server's receive filter - rules are checked in order against the raw header of
+	 * each received packet before it is handled, and the first rule a packet matches decides whether
+	 * it is dropped or accepted. Packets that match no rule are accepted.
+	 */
+	struct CrossReceiveFilterRule
+	{
+		/* The data ID matched - a negative ID matches every data ID */
+		int dataID;
+
+		/* The transmition method matched - a negative method matches both */
+		int method;
+
+		/* The smallest packet size (in bytes, including header and footer) matched */
+		int minPacketSize;
+
+		/* The largest packet size (in bytes, including header and footer) matched */
+		int maxPacketSize;
+
+		/* The senders matched */
+		CrossFilterSender sender;
+
+		/* If above 0, only packets beyond this rate (per second) from a single address are matched */
+		double maxPacketsPerSecond;
+
+		/* The number of packets an address may send at once before its rate is limited */
+		double burstPackets;
+
+		/* If matching packets should be accepted (skipping later rules) instead of dropped */
+		bool shouldAccept;
+
+		/* The number of packets and bytes that matched this rule */
+		size_t matchedPackets;
+		size_t matchedBytes;
+
+		CrossReceiveFilterRule()
+		{
+			dataID = -1;
+			method = -1;
+			minPacketSize = 0;
+			maxPacketSize = INT_MAX;
+			sender = CrossFilterSender::FILTER_ANY_SENDER;
+			maxPacketsPerSecond = 0.0;
+			burstPackets = 0.0;
+			shouldAccept = false;
+			matchedPackets = 0;
+			matchedBytes = 0;
+		}
+	};
+
+	/* Counters of the server's receive filter */
+	struct CrossReceiveFilterStats
+	{
+		size_t checkedPackets;
+		size_t droppedPackets;
+		size_t droppedBytes;
+
+		CrossReceiveFilterStats()
+		{
+			checkedPackets = 0;
+			droppedPackets = 0;
+			droppedBytes = 0;
+		}
+	};
+
+	/*
+	 * The rate limits a filter rule keeps per source address - once full, the address
+	 * heard from least recently gives up its bucket to the new one
+	 */
+	class CrossFilterSources {
+	public:
+
+		/* Gets the bucket of a source address - a new bucket is made (with the given rate) if needed */
+		CrossTokenBucket& GetBucket(const CrossSockAddress& inAddress, double inPacketsPerSecond, double inBurstPackets, double inNow, size_t inMaxSources)
+		{
+			auto source = sources.find(inAddress);
+			if (source != sources.end()) {
+				ages.splice(ages.begin(), ages, source->second.age);
+				return source->second.bucket;
+			}
+
+			/* reuse the stalest source's entry once full */
+			if (sources.size() >= inMaxSources && !ages.empty()) {
+				sources.erase(ages.back());
+				ages.back() = inAddress;
+				ages.splice(ages.begin(), ages, std::prev(ages.end()));
+			}
+			else {
+				ages.push_front(inAddress);
+			}
+			Source& added = sources[inAddress];
+			added.bucket = CrossTokenBucket(inPacketsPerSecond, inBurstPackets, inNow);
+			added.age = ages.begin();
+			return added.bucket;
+		}
+
+		/* Gets the number of source addresses tracked */
+		size_t GetNumSources() const
+		{
+			return sources.size();
+		}
+
+	private:
+		struct Source
+		{
+			CrossTokenBucket bucket;
+			std::list<CrossSockAddress>::iterator age;
+		};
+
+		std::unordered_map<CrossSockAddress, Source> sources;
+		std::list<CrossSockAddress> ages;
+	};
+
+	typedef unsigned int CrossGroupID;
+
+	/* A client's position in a group's member list */
+	struct CrossGroupMembership
+	{
+		CrossGroupID groupID;
+		size_t memberIndex;
+	};
+
+	/* A packet waiting for bandwidth budget */
+	struct CrossShapedPack
+	{
+		CrossPackPtr pack;
+		NetTransMethod method;
+	};
+
+	/* A disconnected client's socket that is still sending its final bytes */
+	struct CrossClosingSocket
+	{
+		TCPSocketPtr socket;
+		std::vector<CrossPackData> pending;
+		size_t bytesSent;
+		double deadline;
+	};
+
 	/* 
 	 * List entry for each connected client - AKA a client as seen
 	 * by the server. Smart pointers are used, as the server could
@@ -53,8 +222,10 @@ namespace CrossSock {
 		CrossClientEntry()
 		{
 			state = CrossClientEntryState::CLIENT_ENTRY_INIT;
-			tcpBufferLength = 0;
+			tcpBurstSize = 0;
+			tcpBacklog = 0;
 			clientID = 0;
+			checksumType = CrossChecksumType::CHECKSUM_SUM;
 			customData = nullptr;
 			timeoutTimer.SetToNow();
 			timeoutDelay = CROSS_SOCK_MAX_TIMEOUT;
@@ -71,6 +242,12 @@ namespace CrossSock {
 			return address;
 		}
 
+		/* Get the address this client's most recent unreliable packet came from */
+		CrossSockAddress GetStreamAddress() const
+		{
+			return streamAddress;
+		}
+
 		/* Get the TCP socket */
 		TCPSocketPtr GetTCPSocket() const
 		{
@@ -121,6 +298,12 @@ namespace CrossSock {
 			return timeoutTimer.GetElapsedTime() >= timeoutDelay;
 		}
 
+		/* Gets the checksum algorithm this client checks packets with - clients older than typed checksums only use CHECKSUM_SUM */
+		CrossChecksumType GetChecksumType() const
+		{
+			return checksumType;
+		}
+
 		/* Gets the most recent ping for this client in ms */
 		double GetPing() const
 		{
@@ -134,6 +317,30 @@ namespace CrossSock {
 			customData = inData;
 		}
 
+		/* Returns true if this client's outbound bandwidth is limited - false otherwise */
+		bool IsBandwidthLimited() const
+		{
+			return sendBucket.IsLimited();
+		}
+
+		/* Gets the number of packets waiting for bandwidth budget */
+		size_t GetNumShapedPacks() const
+		{
+			return shapedQueue.size();
+		}
+
+		/* Gets the number of large messages waiting to be sent to this client in fragments */
+		size_t GetNumQueuedMessages() const
+		{
+			return fragmenter.GetNumMessages();
+		}
+
+		/* Gets the number of groups this client has joined */
+		size_t GetNumGroups() const
+		{
+			return groups.size();
+		}
+
 		/* Gets the custom data object of a given type */
 		template <class T>
 		T* GetCustomData() const
@@ -156,18 +363,69 @@ namespace CrossSock {
 		friend class CrossServer;
 
 		CrossSockAddress address;
+		CrossSockAddress streamAddress;
+		CrossChecksumType checksumType;
 		TCPSocketPtr socket;
 		CrossClientID clientID;
 		CrossClientEntryState state;
-		CrossPackData tcpBuffer[CROSS_SOCK_BUFFER_SIZE];
-		CrossBufferLen tcpBufferLength;
+		CrossRingBufferPtr tcpBuffer;
+		size_t tcpBurstSize;
+		size_t tcpBacklog;
 		double timeoutDelay;
 		CrossTimer timeoutTimer;
 		void* customData;
 		double ping;
+		CrossTokenBucket sendBucket;
+		std::unordered_map<CrossPackDataID, CrossTokenBucket> dataSendBuckets;
+		std::deque<CrossShapedPack> shapedQueue;
+		CrossFragmenter fragmenter;
+		CrossReassembler reassembler;
+		std::vector<CrossPackData> sendTail;
+		std::vector<CrossGroupMembership> groups;
+		CrossPackPtr streamAggregate;
 	};
 
 	typedef std::shared_ptr<CrossSock::CrossClientEntry> CrossClientEntryPtr;
+
+	/*
+	 * A named group (or room) of clients. Members are kept in a dense array,
+	 * so that sending to a group walks a contiguous list instead of the
+	 * server's client map.
+	 */
+	class CrossClientGroup {
+	public:
+
+		/* Get this group's unique ID */
+		CrossGroupID GetGroupID() const
+		{
+			return groupID;
+		}
+
+		/* Get this group's name */
+		std::string GetName() const
+		{
+			return name;
+		}
+
+		/* Get the number of clients in this group */
+		size_t GetNumMembers() const
+		{
+			return members.size();
+		}
+
+		/* Get the client list of this group */
+		const std::vector<CrossClientEntryPtr>& GetMembers() const
+		{
+			return members;
+		}
+
+	private:
+		friend class CrossServer;
+
+		CrossGroupID groupID;
+		std::string name;
+		std::vector<CrossClientEntryPtr> members;
+	};
 }
 
 namespace std
@@ -208,10 +466,26 @@ namespace CrossSock {
 		int maxUDPTransmitsPerUpdate;
 
 		/*
-		 * The maximum number of TCP transmits per update step
+		 * The maximum number of TCP transmits per client per update step - the
+		 * upper bound for backlogged clients that are given a share of
+		 * tcpReceiveBudget
 		 */
 		int maxTCPTransmitsPerUpdate;
 
+		/*
+		 * The number of TCP transmits every client gets per update step no matter
+		 * its share of the receive budget - the fairness floor. Never more than
+		 * maxTCPTransmitsPerUpdate
+		 */
+		int minTCPTransmitsPerUpdate;
+
+		/*
+		 * The number of TCP bytes per update step that are shared between clients
+		 * beyond the fairness floor - each backlogged client gets a share in
+		 * proportion to the unread data it had left in the last update step
+		 */
+		int tcpReceiveBudget;
+
 		/*
 		 * If this server should accept and be able to send connectionless packets
 		 */
@@ -248,17 +522,128 @@ namespace CrossSock {
 		 */
 		double disconnectedClientFlushDelay;
 
+		/*
+		 * The packet size (in bytes) at which reliable broadcasts are sent with
+		 * zero-copy sends - one shared buffer is used for every client instead of
+		 * the kernel copying the packet into each socket. Zero-copy only pays off
+		 * for large sends (around 10 KB and up), and 0 disables it.
+		 */
+		int zeroCopySendThreshold;
+
+		/*
+		 * The maximum number of packets queued per client while waiting for
+		 * bandwidth budget - packets beyond this are dropped
+		 */
+		int maxShapedQueueLength;
+
+		/*
+		 * The socket options applied to the listen socket, the stream socket, and
+		 * every accepted client socket (see CrossSockProfile::LowLatency and
+		 * CrossSockProfile::BulkThroughput)
+		 */
+		CrossSockProfile socketProfile;
+
+		/*
+		 * The maximum datagram size (in bytes) that unreliable packets sent to a
+		 * single client are aggregated into - packets are collected during the
+		 * update and sent together at its end (or on FlushStreams). 1472 fills a
+		 * 1500 byte ethernet MTU, and 0 disables aggregation.
+		 */
+		int streamAggregateSize;
+
+		/*
+		 * How long (in ms) a disconnected client's socket is kept open to finish
+		 * sending its disconnect packet when the send buffer is full
+		 */
+		double disconnectSendTimeout;
+
+		/*
+		 * The maximum number of clients disconnected per update step while the
+		 * server is draining
+		 */
+		int drainBatchSize;
+
+		/*
+		 * If the kernel may coalesce datagrams from the same client into a single
+		 * receive (UDP_GRO, linux only) - cuts the per-datagram cost of bulk uploads
+		 * at the cost of 1 MB of receive slots
+		 */
+		bool allowUDPReceiveOffload;
+
+		/*
+		 * The number of UDP stream sockets sharing the server's port (SO_REUSEPORT,
+		 * linux only) - the kernel steers each client's datagrams to the socket
+		 * given by GetStreamShard, so every socket has its own receive queue. Falls
+		 * back to a single socket if the sockets can't share the port.
+		 */
+		int numStreamShards;
+
+		/*
+		 * If the kernel receive time (SO_TIMESTAMPING, linux only) of every packet
+		 * should be recorded - see CrossPack::GetReceiveTime. Separates the time a
+		 * packet waited in this process from its time on the network.
+		 */
+		bool useReceiveTimestamps;
+
+		/*
+		 * The largest message (in bytes) a client may send to message handlers -
+		 * messages too large for a single packet are sent in fragments and
+		 * reassembled before they are handled
+		 */
+		int maxMessageSize;
+
+		/*
+		 * The memory (in bytes) each client may hold in unfinished messages -
+		 * fragments of messages that don't fit are dropped
+		 */
+		int maxReassemblyBytes;
+
+		/*
+		 * How long (in ms) an unfinished message is kept without receiving a
+		 * fragment - lost UDP fragments leave their message unfinished
+		 */
+		double fragmentTimeout;
+
+		/*
+		 * The number of fragment bytes sent to each client per update step - the
+		 * rest wait for later updates, so that a large message doesn't hold back
+		 * the packets sent after it
+		 */
+		int fragmentBytesPerUpdate;
+
+		/*
+		 * The checksum algorithm used on this server's connections - clients are
+		 * told during the handshake, and packets should be finalized with it (see
+		 * CrossServer::GetChecksumType and CrossClient::GetChecksumType)
+		 */
+		CrossChecksumType checksumType;
+
 		CrossServerProperties()
 		{
 			newConnectionBacklog = 32;
 			maxUDPTransmitsPerUpdate = 256;
-			maxTCPTransmitsPerUpdate = 4;
+			maxTCPTransmitsPerUpdate = 64;
+			minTCPTransmitsPerUpdate = 4;
+			tcpReceiveBudget = 4194304;
 			allowUDPPackets = true;
 			useBlacklist = true;
 			useWhitelist = false;
 			alivenessTestDelay = 1000.0;
 			shouldFlushDisconnectedClientData = true;
 			disconnectedClientFlushDelay = CROSS_SOCK_MAX_TIMEOUT;
+			zeroCopySendThreshold = 0;
+			maxShapedQueueLength = 256;
+			streamAggregateSize = 0;
+			disconnectSendTimeout = 1000.0;
+			drainBatchSize = 256;
+			allowUDPReceiveOffload = false;
+			numStreamShards = 1;
+			useReceiveTimestamps = false;
+			maxMessageSize = 4194304;
+			maxReassemblyBytes = 8388608;
+			fragmentTimeout = 5000.0;
+			fragmentBytesPerUpdate = 131072;
+			checksumType = CrossChecksumType::CHECKSUM_CRC32C;
 		}
 	};
 
@@ -271,7 +656,10 @@ namespace CrossSock {
 		SERVER_BINDING = 1,
 
 		/* Servicing connected clients */
-		SERVER_LOOP = 2
+		SERVER_LOOP = 2,
+
+		/* No longer accepting clients - disconnecting connected clients before stopping */
+		SERVER_DRAINING = 3
 	};
 
 	/* A high level server object */
@@ -284,10 +672,18 @@ namespace CrossSock {
 			streamSocket = nullptr;
 			serverProperties = CrossServerProperties();
 			streamIsBound = false;
-			udpBufferLength = 0;
+			AllocateDatagramSlots(UDPSocket::MAX_RECEIVE_BATCH, CrossPack::GetMaxPacketSize() + 1);
 			nextAvailableClientID = 1;
 			nextAvailableDataID = StaticDataID::CUSTOM_DATA_START;
+			nextAvailableGroupID = 1;
 			serverState = CrossServerState::SERVER_NEEDS_STARTUP;
+			serverClock.SetToNow();
+			tickTime = 0.0;
+			drainDeadline = 0.0;
+			tcpTotalBacklog = 0;
+			nextStreamShard = 0;
+			receiveTime = 0;
+			tcpScratchBuffer = tcpBufferPool.Acquire(CROSS_SOCK_BUFFER_SIZE);
 			connectEvent = nullptr;
 			disconnectEvent = nullptr;
 			reconnectEvent = nullptr;
@@ -297,6 +693,7 @@ namespace CrossSock {
 			readyEvent = nullptr;
 			rejectEvent = nullptr;
 			bindEvent = nullptr;
+			drainedEvent = nullptr;
 			validateEvent = nullptr;
 			receiveEvent = nullptr;
 			transErrorEvent = nullptr;
@@ -321,6 +718,9 @@ namespace CrossSock {
 			for (auto it = dataEvents.begin(); it != dataEvents.end(); ++it) {
 				delete *it;
 			}
+			for (auto it = messageEvents.begin(); it != messageEvents.end(); ++it) {
+				delete *it;
+			}
 			delete connectEvent;
 			delete disconnectEvent;
 			delete reconnectEvent;
@@ -330,6 +730,7 @@ namespace CrossSock {
 			delete readyEvent;
 			delete rejectEvent;
 			delete bindEvent;
+			delete drainedEvent;
 			delete validateEvent;
 			delete receiveEvent;
 			delete transErrorEvent;
@@ -345,7 +746,10 @@ namespace CrossSock {
 			Update();
 		}
 
-		/* Stop this server - disconnects all connected clients */
+		/*
+		 * Stop this server - disconnects all connected clients without blocking. Disconnect
+		 * packets that don't fit in a client's send buffer are dropped, use Drain to stop gracefully.
+		 */
 		void Stop()
 		{
 			if (serverState != CrossServerState::SERVER_NEEDS_STARTUP) {
@@ -366,31 +770,59 @@ namespace CrossSock {
 					disconnectedClient.reset();
 				}
 				disconnectedClients.clear();
+				for (size_t c = 0; c < closingSockets.size(); c++) {
+					closingSockets[c].socket->Close();
+				}
+				closingSockets.clear();
+				pendingAggregates.clear();
 				if (listenSocket) {
 					listenSocket->Close();
 					listenSocket.reset();
 				}
-				if (streamSocket) {
-					streamSocket->Close();
-					streamSocket.reset();
-				}
-				streamIsBound = false;
-				udpBufferLength = 0;
+				CloseStreamSockets();
 				serverState = CrossServerState::SERVER_NEEDS_STARTUP;
 			}
 		}
 
+		/*
+		 * Gracefully stop this server - stops accepting new clients, then disconnects connected
+		 * clients in batches over the following updates without blocking. The server stops and
+		 * the drained handler is called once every disconnect packet has been sent, or once the
+		 * deadline (in ms) has passed.
+		 */
+		void Drain(double inDeadline = 5000.0)
+		{
+			if (serverState == CrossServerState::SERVER_LOOP) {
+				if (listenSocket) {
+					listenSocket->Close();
+					listenSocket.reset();
+				}
+				drainDeadline = serverClock.GetElapsedTime() + inDeadline;
+				serverState = CrossServerState::SERVER_DRAINING;
+			}
+			else if (serverState == CrossServerState::SERVER_BINDING) {
+				Stop();
+				if (drainedEvent && drainedEvent->IsValid())
+					drainedEvent->Execute();
+			}
+		}
+
 		/* Automatically connects clients and receives data */
 		void Update()
 		{
+			/* cache this update step's time for bandwidth shaping */
+			tickTime = serverClock.GetElapsedTime();
+
 			/* if the listen socket still needs to be bound */
 			if (serverState == CrossServerState::SERVER_BINDING) {
 
 				/* if the listen socket is invalid */
 				if (!listenSocket) {
 					listenSocket = CrossSockUtil::CreateTCPSocket(addressFamily);
-					if (listenSocket)
+					if (listenSocket) {
 						listenSocket->SetNonBlockingMode(true);
+						listenSocket->ApplyProfile(serverProperties.socketProfile);
+					}
 				}
 
 				/* if the listen socket is valid */
@@ -411,56 +843,70 @@ namespace CrossSock {
 					}
 				}
 			}
-			else if (serverState == CrossServerState::SERVER_LOOP) { /* else if running */
+			else if (serverState == CrossServerState::SERVER_LOOP || serverState == CrossServerState::SERVER_DRAINING) { /* else if running */
 
-				/* hey! listen! */
-				listenSocket->Listen(serverProperties.newConnectionBacklog);
+				if (serverState == CrossServerState::SERVER_LOOP) {
+					/* hey! listen! */
+					listenSocket->Listen(serverProperties.newConnectionBacklog);
 
-				/* accept and validate new connections*/
-				int newConnections = 0;
-				int err;
-				do {
+					/* accept and validate new connections*/
+					int newConnections = 0;
+					do {
 
-					/* increment connections counter */
-					newConnections++;
-
-					/* accept new clients */
-					CrossSockAddress newClientAddress;
-					TCPSocketPtr newSocket = listenSocket->Accept(newClientAddress);
-					err = CrossSockUtil::GetLastError();
-					if (err == CrossSockError::SUCCESS) {
-
-						/* assemble new client entry */
-						newSocket->SetNonBlockingMode(true);
-						CrossClientEntryPtr newEntry = std::make_shared<CrossClientEntry>();
-						newEntry->address = newClientAddress;
-						newEntry->socket = newSocket;
-						newEntry->clientID = nextAvailableClientID;
-
-						/* get connection list entry */
-						bool canConnect = false;
-						bool onList = false;
-						auto itr = canConnectList.find(newClientAddress);
-						if (itr != canConnectList.end()) {
-							canConnect = itr->second;
-							onList = true;
-						}
+						/* increment connections counter */
+						newConnections++;
+
+						/* accept new clients */
+						CrossSockAddress newClientAddress;
+						TCPSocketPtr newSocket = listenSocket->Accept(newClientAddress);
+						if (newSocket) {
+
+							/* assemble new client entry */
+							newSocket->SetNonBlockingMode(true);
+							newSocket->ApplyProfile(serverProperties.socketProfile);
+							if (serverProperties.zeroCopySendThreshold > 0)
+								newSocket->SetZeroCopyMode(true);
+							if (serverProperties.useReceiveTimestamps)
+								newSocket->SetReceiveTimestampMode(true);
+							CrossClientEntryPtr newEntry = std::make_shared<CrossClientEntry>();
+							newEntry->address = newClientAddress;
+							newEntry->socket = newSocket;
+							newEntry->clientID = nextAvailableClientID;
+
+							/* get connection list entry */
+							bool canConnect = false;
+							bool onList = false;
+							auto itr = canConnectList.find(newClientAddress);
+							if (itr != canConnectList.end()) {
+								canConnect = itr->second;
+								onList = true;
+							}
+
+							/* validate against blacklist */
+							if (!serverProperties.useBlacklist || !onList || canConnect) {
+								/* validate against whitelist */
+								if (!serverProperties.useWhitelist || canConnect) {
+									/* do custom client connection validation */
+									if (!validateEvent || !validateEvent->IsValid() || validateEvent->Execute(newEntry))
+									{
+										/* accept connection */
+										nextAvailableClientID++;
+										connectedClients[newEntry->clientID] = newEntry;
+
+										/* send init packet */
+										CrossPack pack;
+										pack.SetDataID(StaticDataID::HANDSHAKE);
+										pack.AddToPayload<unsigned char>((unsigned char)serverProperties.checksumType);
+										SendToClient(&pack, newEntry);
+									}
+									else {
+										/* execute callback */
+										if (rejectEvent && rejectEvent->IsValid())
+											rejectEvent->Execute(newEntry);
 
-						/* validate against blacklist */
-						if (!serverProperties.useBlacklist || !onList || canConnect) {
-							/* validate against whitelist */
-							if (!serverProperties.useWhitelist || canConnect) {
-								/* do custom client connection validation */
-								if (!validateEvent || !validateEvent->IsValid() || validateEvent->Execute(newEntry))
-								{
-									/* accept connection */
-									nextAvailableClientID++;
-									connectedClients[newEntry->clientID] = newEntry;
-
-									/* send init packet */
-									CrossPack pack;
-									pack.SetDataID(StaticDataID::HANDSHAKE);
-									SendToClient(&pack, newEntry);
+										/* reject connection */
+										DisconnectClient(newEntry);
+									}
 								}
 								else {
 									/* execute callback */
@@ -480,19 +926,26 @@ namespace CrossSock {
 								DisconnectClient(newEntry);
 							}
 						}
-						else {
-							/* execute callback */
-							if (rejectEvent && rejectEvent->IsValid())
-								rejectEvent->Execute(newEntry);
-
-							/* reject connection */
-							DisconnectClient(newEntry);
+						else { /* else failed to accept new connection - stop trying to accept new clients */
+							break;
 						}
+					} while (newConnections < serverProperties.newConnectionBacklog);
+				}
+				else { /* disconnect the next batch of clients */
+					int disconnects = 0;
+					auto it = connectedClients.begin();
+					while (it != connectedClients.end() && disconnects < serverProperties.drainBatchSize) {
+						if (it->second && it->second->IsRunning()) {
+							DisconnectClient(it->second, false);
+							disconnects++;
+						}
+						it++;
 					}
-					else { /* else failed to accept new connection - stop trying to accept new clients */
-						break;
-					}
-				} while (newConnections < serverProperties.newConnectionBacklog);
+				}
+
+				/* finish sending to disconnected clients */
+				if (!closingSockets.empty())
+					FlushClosingSockets();
 
 				/* do aliveness test if possible */
 				if (alivenessTestTimer.GetElapsedTime() >= serverProperties.alivenessTestDelay) {
@@ -510,8 +963,8 @@ namespace CrossSock {
 						alivenessTest.ClearPayload();
 						alivenessTest.AddToPayload<float>((float)((serverProperties.alivenessTestDelay + it->second->GetPing()) * CROSS_SOCK_TIMEOUT_FACTOR));
 
-						// do aliveness test
-						int result = SendToClient(&alivenessTest, it->second);
+						// do aliveness test - without blocking, so that a client that isn't reading can't stall the server
+						int result = QueueToClient(&alivenessTest, it->second);
 						if (result < 0 || it->second->HasTimedOut()) {
 							DisconnectClient(it->second);
 						}
@@ -536,34 +989,99 @@ namespace CrossSock {
 					}
 				}
 
-				/* handle TCP data */
+				/* close disconnected sockets once the kernel is done with their zero-copy sends */
+				TCPSocket::PollLingeringZeroCopySends();
+
+				/* handle TCP data - the receive budget is shared by last update's backlogs */
+				size_t lastTCPBacklog = tcpTotalBacklog;
+				tcpTotalBacklog = 0;
 				auto it = connectedClients.begin();
 				while (it != connectedClients.end()) {
 					if (it->second && it->second->IsRunning()) {
 						CrossClientEntryPtr client = it->second;
 						it++;
+
+						/* release broadcast buffers the kernel is done with */
+						if (client->socket->GetPendingZeroCopySends() > 0)
+							client->socket->PollZeroCopyCompletions();
+
+						/* send the rest of a packet cut short by a full socket */
+						if (!client->sendTail.empty())
+							FlushSendTail(client, false);
+
+						/* send packets that were waiting for bandwidth budget */
+						if (!client->shapedQueue.empty())
+							FlushShapedPacks(client);
+
+						/* send the next fragments of large messages, and drop unfinished messages that went quiet */
+						if (client->fragmenter.GetNumMessages() > 0)
+							FlushFragments(client);
+						if (client->reassembler.GetNumMessages() > 0)
+							client->reassembler.DropStaleMessages(tickTime - serverProperties.fragmentTimeout, messageBufferPool);
+
+						size_t receiveAllowance = 0;
+						if (client->tcpBacklog > 0 && lastTCPBacklog > 0 && serverProperties.tcpReceiveBudget > 0)
+							receiveAllowance = (size_t)((double)serverProperties.tcpReceiveBudget * client->tcpBacklog / lastTCPBacklog);
+
+						int minTransmits = serverProperties.minTCPTransmitsPerUpdate;
+						if (minTransmits > serverProperties.maxTCPTransmitsPerUpdate)
+							minTransmits = serverProperties.maxTCPTransmitsPerUpdate;
+
 						CrossBufferLen bytesReceived;
+						size_t burstSize = 0;
 						int tcpTransmits = 0;
 						do {
 							tcpTransmits++;
-							bytesReceived = client->socket->Receive(client->tcpBuffer + client->tcpBufferLength, CROSS_SOCK_BUFFER_SIZE - client->tcpBufferLength);
+
+							/* clients without unread data receive into the shared scratch buffer */
+							bool isScratch = !client->tcpBuffer;
+							CrossRingBuffer* buffer = isScratch ? tcpScratchBuffer.get() : client->tcpBuffer.get();
+							CrossPackData* writePtr = buffer->GetWritePtr();
+							bytesReceived = client->socket->Receive(writePtr, (int)buffer->GetWriteSpace(), receiveTime);
 							if (bytesReceived > 0) {
-								client->tcpBufferLength += bytesReceived;
+								buffer->Commit(bytesReceived);
+								burstSize += bytesReceived;
+
+								/* parse packets in place - unparsed bytes stay where they are */
 								CrossBufferLen dataUsed;
-								CrossBufferLen bufferPos = 0;
 								do {
-									dataUsed = OnReceiveNewData(client->tcpBuffer + bufferPos, client->tcpBufferLength - bufferPos, client, NetTransMethod::TCP);
-									bufferPos += dataUsed;
-								} while (IsRunning() && client && client->IsRunning() && dataUsed > 0 && bufferPos < client->tcpBufferLength);
-
-								/* reset buffer to front */
-								client->tcpBufferLength -= bufferPos;
-								memcpy(client->tcpBuffer, client->tcpBuffer + bufferPos, client->tcpBufferLength);
+									dataUsed = OnReceiveNewData(buffer->GetReadPtr(), (CrossBufferLen)buffer->GetSize(), client, NetTransMethod::TCP);
+									buffer->Consume(dataUsed);
+								} while (IsRunning() && client && client->IsRunning() && dataUsed > 0 && buffer->GetSize() > 0);
+
+								/* move a partial packet out of the scratch buffer */
+								if (isScratch) {
+									if (buffer->GetSize() > 0 && client->IsRunning())
+										MoveReceiveBuffer(client, *buffer, client->tcpBurstSize + CrossPack::GetMaxPacketSize());
+									buffer->Clear();
+								}
 							}
 							else if (CrossSockUtil::GetLastError() == CrossSockError::CONNRESET) {
 								DisconnectClient(client);
 							}
-						} while (IsRunning() && client && client->IsRunning() && bytesReceived > 0 && tcpTransmits < serverProperties.maxTCPTransmitsPerUpdate);
+						} while (IsRunning() && client && client->IsRunning() && bytesReceived > 0 && (tcpTransmits < minTransmits
+							|| (burstSize < receiveAllowance && tcpTransmits < serverProperties.maxTCPTransmitsPerUpdate)));
+
+						/* a client that still had data when its budget ran out is backlogged */
+						client->tcpBacklog = 0;
+						if (bytesReceived > 0 && client->IsRunning()) {
+							int bytesAvailable = client->socket->GetBytesAvailable();
+							client->tcpBacklog = bytesAvailable >= 0 ? (size_t)bytesAvailable : (size_t)bytesReceived;
+							tcpTotalBacklog += client->tcpBacklog;
+						}
+
+						/* track this client's burst size, and fit or return its buffer */
+						client->tcpBurstSize = (client->tcpBurstSize * 3 + burstSize) / 4;
+						if (client->tcpBuffer) {
+							size_t fittedSize = client->tcpBurstSize + CrossPack::GetMaxPacketSize();
+							if (client->tcpBuffer->GetSize() == 0)
+								tcpBufferPool.Release(client->tcpBuffer);
+							else if (CrossRingBufferPool::GetSizeClass(fittedSize) != CrossRingBufferPool::GetSizeClass(client->tcpBuffer->GetCapacity()) && client->tcpBuffer->GetSize() < fittedSize) {
+								CrossRingBufferPtr oldBuffer = std::move(client->tcpBuffer);
+								MoveReceiveBuffer(client, *oldBuffer, fittedSize);
+								tcpBufferPool.Release(oldBuffer);
+							}
+						}
 					}
 					else {
 						it++;
@@ -573,63 +1091,52 @@ namespace CrossSock {
 				/* handle UDP data */
 				if (serverProperties.allowUDPPackets) {
 					if (streamIsBound) {
-						CrossBufferLen bytesReceived;
+						/* the first shard served rotates so that no shard starves the others */
 						int udpTransmits = 0;
-						do {
-							udpTransmits++;
-							CrossSockAddress fromAddress;
-							bytesReceived = streamSocket->ReceiveFrom(udpBuffer + udpBufferLength, CROSS_SOCK_BUFFER_SIZE - udpBufferLength, fromAddress);
-							if (bytesReceived > 0) {
-								udpBufferLength += bytesReceived;
-								CrossBufferLen dataUsed;
-								CrossBufferLen bufferPos = 0;
-								do {
-									dataUsed = OnReceiveNewData(udpBuffer + bufferPos, udpBufferLength - bufferPos, nullptr, NetTransMethod::UDP);
-									bufferPos += dataUsed;
-								} while (IsRunning() && streamIsBound && dataUsed > 0 && bufferPos < udpBufferLength);
-
-								/* reset buffer to front */
-								udpBufferLength -= bufferPos;
-								memcpy(udpBuffer, udpBuffer + bufferPos, udpBufferLength);
-							}
-							else if (CrossSockUtil::GetLastError() == CrossSockError::CONNRESET) {
-								streamIsBound = false;
-								udpBufferLength = 0;
-								if (streamSocket) {
-									streamSocket->Close();
-									streamSocket.reset();
-								}
-							}
-						} while (IsRunning() && streamIsBound && bytesReceived > 0 && udpTransmits < serverProperties.maxUDPTransmitsPerUpdate);
+						size_t firstShard = nextStreamShard++;
+						for (size_t s = 0; s < streamShards.size() && IsRunning() && streamIsBound && udpTransmits < serverProperties.maxUDPTransmitsPerUpdate; s++) {
+							ReceiveDatagrams(streamShards[(firstShard + s) % streamShards.size()], udpTransmits);
+						}
 					}
 					else { /* bind UDP socket if needed */
-						if (!streamSocket) {
-							streamSocket = CrossSockUtil::CreateUDPSocket(addressFamily);
-							if (streamSocket)
-								streamSocket->SetNonBlockingMode(true);
-						}
+						if (!streamSocket)
+							streamSocket = CreateStreamSocket();
 						if (streamSocket) {
 							CrossSockAddress address(CrossSockAddress::ANY_ADDRESS, port, addressFamily);
 							int result = streamSocket->Bind(address);
 							int err = CrossSockUtil::GetLastError();
-							if (result >= 0 || (err == CrossSockError::SUCCESS || err == CrossSockError::ISCONN))
+							if (result >= 0 || (err == CrossSockError::SUCCESS || err == CrossSockError::ISCONN)) {
 								streamIsBound = true;
+								BindStreamShards(address);
+							}
 						}
 					}
 				}
 
+				/* send the unreliable packets aggregated during this update */
+				FlushStreams();
+
 				/* consider disconnecting clients */
 				it = connectedClients.begin();
 				while (it != connectedClients.end()) {
 
 					/* destroy and remove client if no longer running */
 					if (it->second == nullptr || !(it->second->IsRunning())) {
+						if (it->second)
+							tcpBufferPool.Release(it->second->tcpBuffer);
 						it = connectedClients.erase(it);
 					}
 					else {
 						it++;
 					}
 				}
+
+				/* stop once drained */
+				if (serverState == CrossServerState::SERVER_DRAINING && ((connectedClients.empty() && closingSockets.empty()) || tickTime >= drainDeadline)) {
+					Stop();
+					if (drainedEvent && drainedEvent->IsValid())
+						drainedEvent->Execute();
+				}
 			}
 		}
 
@@ -704,35 +1211,58 @@ namespace CrossSock {
 			if (!inClient || inClient->state == CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED)
 				return NetTransError::CLIENT_NOT_CONNECTED;
 			else {
-				/* send until succesful */
 				int result;
-				do {
-					result = inClient->socket->Send(inPack->Serialize(), inPack->GetPacketSize());
-				} while (inShouldBlockUntilSent && result < 0 && CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK);
-				return result;
+				if (!PassesShaping(inPack, inClient, NetTransMethod::TCP, result))
+					return result;
+				return TransmitToClient(inPack, inClient, inShouldBlockUntilSent);
+			}
+		}
+
+		/*
+		 * Send a packet reliably to a client, handing its buffer over instead of copying it wherever the packet
+		 * outlives the call (a shaping queue or a zero-copy send) - returns the number of bytes sent if succesful,
+		 * or the NetTransError if unsuccesful. The packet is always left empty, ready to be refilled
+		 */
+		int SendToClient(CrossPack&& inPack, const CrossClientEntryPtr inClient, const bool inShouldBlockUntilSent = true) const
+		{
+			int result = NetTransError::CLIENT_NOT_CONNECTED;
+			if (inClient && inClient->state != CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED
+				&& PassesShaping(&inPack, inClient, NetTransMethod::TCP, result, &inPack)) {
+				if (serverProperties.zeroCopySendThreshold > 0 && inPack.GetPacketSize() >= serverProperties.zeroCopySendThreshold) {
+					CrossPackPtr ownedPack = CrossPackPool::Acquire(std::move(inPack));
+					std::shared_ptr<CrossPackData> sharedData(ownedPack, const_cast<CrossPackData*>(ownedPack->Serialize()));
+					result = TransmitToClient(ownedPack.get(), inClient, inShouldBlockUntilSent, sharedData);
+				}
+				else
+					result = TransmitToClient(&inPack, inClient, inShouldBlockUntilSent);
 			}
+			inPack.ClearPayload();
+			return result;
 		}
 
-		/* Send a packet reliably to all connected clients */
-		void SendToAll(const CrossPackPtr inPack, const bool inShouldBlockUntilSent = true) const
+		/* Send a packet reliably to all connected clients - returns the number of clients the whole packet was sent or queued to */
+		int SendToAll(const CrossPackPtr inPack, const bool inShouldBlockUntilSent = true) const
 		{
 			return SendToAll(inPack.get(), inShouldBlockUntilSent);
 		}
 
-		/* Send a packet reliably to all connected clients */
-		void SendToAll(const CrossPack* inPack, const bool inShouldBlockUntilSent = true) const
+		/* Send a packet reliably to all connected clients - returns the number of clients the whole packet was sent or queued to */
+		int SendToAll(const CrossPack* inPack, const bool inShouldBlockUntilSent = true) const
 		{
+			std::shared_ptr<CrossPackData> sharedData = ShareForZeroCopy(inPack);
+			int numSent = 0;
 			auto it = connectedClients.begin();
 			while (it != connectedClients.end()) {
+				int result;
 				if (it->second && it->second->state != CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED) {
-					/* send until succesful */
-					int result;
-					do {
-						result = it->second->socket->Send(inPack->Serialize(), inPack->GetPacketSize());
-					} while (inShouldBlockUntilSent && result < 0 && CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK);
+					if (PassesShaping(inPack, it->second, NetTransMethod::TCP, result))
+						result = TransmitToClient(inPack, it->second, inShouldBlockUntilSent, sharedData) - inPack->GetPacketSize();
+					if (result == 0)
+						numSent++;
 				}
 				it++;
 			}
+			return numSent;
 		}
 
 		/* Send a packet unreliably to a client - returns the number of bytes sent if succesful, or the NetTransError if unsuccesful. WARNING: Will finalize the packet automatically */
@@ -750,62 +1280,467 @@ namespace CrossSock {
 				return NetTransError::STREAM_NOT_BOUND;
 			else {
 
-				/* finalize if necessary */
+				/* finalize if necessary, and check the packet with the client's checksum algorithm */
 				if (!inPack->IsFinalized()) {
 					inPack->Finalize(false, true, GetServerID());
 				}
+				inPack->SetChecksumType(inClient->checksumType);
 
-				/* send until succesful */
 				int result;
-				do {
-					result = streamSocket->SendTo(inPack->Serialize(), inPack->GetPacketSize(), inClient->address);
-				} while (inShouldBlockUntilSent && result < 0 && CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK);
-				return result;
+				if (!PassesShaping(inPack, inClient, NetTransMethod::UDP, result))
+					return result;
+				if (serverProperties.streamAggregateSize > 0)
+					return AggregateStreamToClient(inPack, inClient, inShouldBlockUntilSent);
+				return TransmitStreamToClient(inPack, inClient, inShouldBlockUntilSent);
 			}
 		}
 
-		/* Send a packet unreliably to all connected clients. WARNING: Will finalize the packet automatically */
-		void StreamToAll(const CrossPackPtr inPack, const bool inShouldBlockUntilSent = true) const
-		{
-			return StreamToAll(inPack.get(), inShouldBlockUntilSent);
-		}
-
-		/* Send a packet unreliably to all connected clients. WARNING: Will finalize the packet automatically */
-		void StreamToAll(const CrossPack* inPack, const bool inShouldBlockUntilSent = true) const
+		/* Send a packet unreliably to a client, handing its buffer to the shaping queue instead of copying it if it must wait - the packet is always left empty, ready to be refilled. WARNING: Will finalize the packet automatically */
+		int StreamToClient(CrossPack&& inPack, const CrossClientEntryPtr inClient, const bool inShouldBlockUntilSent = true) const
 		{
-			if (streamIsBound) {
+			int result;
+			if (!inClient || inClient->state == CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED)
+				result = NetTransError::CLIENT_NOT_CONNECTED;
+			else if (!streamIsBound)
+				result = NetTransError::STREAM_NOT_BOUND;
+			else {
 
-				/* finalize if necessary */
-				if (!inPack->IsFinalized()) {
-					inPack->Finalize(false, true, GetServerID());
+				/* finalize if necessary, and check the packet with the client's checksum algorithm */
+				if (!inPack.IsFinalized()) {
+					inPack.Finalize(false, true, GetServerID());
 				}
+				inPack.SetChecksumType(inClient->checksumType);
 
-				auto it = connectedClients.begin();
-				while (it != connectedClients.end()) {
-					if (it->second && it->second->state != CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED) {
-						/* send until succesful */
-						int result;
-						do {
-							streamSocket->SendTo(inPack->Serialize(), inPack->GetPacketSize(), it->second->address);
-						} while (inShouldBlockUntilSent && result < 0 && CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK);
-					}
-					it++;
+				if (PassesShaping(&inPack, inClient, NetTransMethod::UDP, result, &inPack)) {
+					if (serverProperties.streamAggregateSize > 0)
+						result = AggregateStreamToClient(&inPack, inClient, inShouldBlockUntilSent);
+					else
+						result = TransmitStreamToClient(&inPack, inClient, inShouldBlockUntilSent);
 				}
 			}
+			inPack.ClearPayload();
+			return result;
 		}
 
-		/* Get the server's listen socket used to connect new clients */
-		TCPSocketPtr GetListenSocket() const
+		/*
+		 * Send a message of any size reliably to a client's message handlers - returns the number of bytes sent or queued
+		 * if succesful, or the NetTransError if unsuccesful. Messages too large for a single packet are copied and sent in
+		 * fragments over the following update steps (see CrossServerProperties::fragmentBytesPerUpdate), taking turns with
+		 * the client's other large messages - so messages sent after a large message may be handled before it
+		 */
+		int SendMessageToClient(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize, const CrossClientEntryPtr inClient)
 		{
-			return listenSocket;
+			return QueueMessage(inDataID, inData, inSize, inClient, NetTransMethod::TCP);
 		}
 
-		/* Get the server's stream socket used to transmit and receive UDP packets */
-		UDPSocketPtr GetStreamSocket() const
+		/*
+		 * Send a message of any size unreliably to a client's message handlers - returns the number of bytes sent or queued
+		 * if succesful, or the NetTransError if unsuccesful. Large messages are sent in fragments as with SendMessageToClient,
+		 * and are lost if any of their fragments are
+		 */
+		int StreamMessageToClient(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize, const CrossClientEntryPtr inClient)
+		{
+			return QueueMessage(inDataID, inData, inSize, inClient, NetTransMethod::UDP);
+		}
+
+		/* Send a burst of packets unreliably to a client - returns the number of bytes sent if succesful, or the NetTransError if unsuccesful. WARNING: Will finalize the packets automatically */
+		int StreamToClient(const std::vector<CrossPackPtr>& inPacks, const CrossClientEntryPtr inClient, const bool inShouldBlockUntilSent = true) const
+		{
+			streamBatchPacks.clear();
+			for (size_t p = 0; p < inPacks.size(); p++) {
+				streamBatchPacks.push_back(inPacks[p].get());
+			}
+			return StreamToClient(streamBatchPacks.data(), (int)streamBatchPacks.size(), inClient, inShouldBlockUntilSent);
+		}
+
+		/*
+		 * Send a burst of packets unreliably to a client - returns the number of bytes sent if succesful, or
+		 * the NetTransError if unsuccesful. Runs of equal-size packets are copied into one contiguous buffer
+		 * and sent with a single segmented send (see UDPSocket::SendSegmentsTo). A non-blocking send stops at
+		 * the first datagram the socket can't take, so fewer bytes than the packets hold may be returned.
+		 * WARNING: Will finalize the packets automatically
+		 */
+		int StreamToClient(const CrossPack* const* inPacks, int inNumPacks, const CrossClientEntryPtr inClient, const bool inShouldBlockUntilSent = true) const
+		{
+			if (!inClient || inClient->state == CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED)
+				return NetTransError::CLIENT_NOT_CONNECTED;
+			else if (!streamIsBound)
+				return NetTransError::STREAM_NOT_BOUND;
+
+			int totalSent = 0;
+			int p = 0;
+			while (p < inNumPacks) {
+
+				/* gather a run of equal-size packets - the last packet of a run may be shorter */
+				streamBatchBuffer.clear();
+				int segmentSize = 0;
+				for (; p < inNumPacks; p++) {
+					const CrossPack* pack = inPacks[p];
+					if (!pack->IsFinalized()) {
+						pack->Finalize(false, true, GetServerID());
+					}
+					pack->SetChecksumType(inClient->checksumType);
+					int packetSize = pack->GetPacketSize();
+					if (segmentSize != 0 && packetSize > segmentSize)
+						break;
+
+					int result;
+					if (!PassesShaping(pack, inClient, NetTransMethod::UDP, result))
+						continue;
+					const CrossPackData* data = pack->Serialize();
+					streamBatchBuffer.insert(streamBatchBuffer.end(), data, data + packetSize);
+					if (segmentSize == 0) {
+						segmentSize = packetSize;
+					}
+					else if (packetSize < segmentSize) {
+						p++;
+						break;
+					}
+				}
+				if (streamBatchBuffer.empty())
+					continue;
+
+				/* send until the whole run is out - a burst can be cut short part way through */
+				int runSize = (int)streamBatchBuffer.size();
+				int runSent = 0;
+				int result;
+				do {
+					result = streamSocket->SendSegmentsTo(streamBatchBuffer.data() + runSent, runSize - runSent, segmentSize, inClient->address);
+					if (result > 0)
+						runSent += result;
+				} while (inShouldBlockUntilSent && runSent < runSize && (result > 0 || CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK));
+				totalSent += runSent;
+				if (runSent < runSize)
+					return (totalSent > 0) ? totalSent : result;
+			}
+			return totalSent;
+		}
+
+		/* Send a packet unreliably to all connected clients. WARNING: Will finalize the packet automatically */
+		void StreamToAll(const CrossPackPtr inPack, const bool inShouldBlockUntilSent = true) const
+		{
+			return StreamToAll(inPack.get(), inShouldBlockUntilSent);
+		}
+
+		/* Send a packet unreliably to all connected clients. WARNING: Will finalize the packet automatically */
+		void StreamToAll(const CrossPack* inPack, const bool inShouldBlockUntilSent = true) const
+		{
+			if (streamIsBound) {
+
+				/* finalize if necessary */
+				if (!inPack->IsFinalized()) {
+					inPack->Finalize(false, true, GetServerID());
+				}
+
+				/* gather the client addresses and hand them to the kernel in batches */
+				streamTargets.clear();
+				streamTargetChecksums.clear();
+				auto it = connectedClients.begin();
+				while (it != connectedClients.end()) {
+					int result;
+					if (it->second && it->second->state != CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED && PassesShaping(inPack, it->second, NetTransMethod::UDP, result)) {
+						streamTargets.push_back(it->second->address);
+						streamTargetChecksums.push_back(it->second->checksumType);
+					}
+					it++;
+				}
+				TransmitStreamToTargets(inPack, inShouldBlockUntilSent);
+			}
+		}
+
+		/* Create a group with the given name - returns the existing group's ID if the name is taken */
+		CrossGroupID CreateGroup(const std::string& inGroupName)
+		{
+			CrossGroupID groupID = GetGroupID(inGroupName);
+			if (groupID == 0) {
+				groupID = nextAvailableGroupID;
+				nextAvailableGroupID++;
+				CrossClientGroup& group = groups[groupID];
+				group.groupID = groupID;
+				group.name = inGroupName;
+			}
+			return groupID;
+		}
+
+		/* Destroy a group, removing all of its members - returns false if no such group exists */
+		bool DestroyGroup(const CrossGroupID& inGroupID)
+		{
+			auto group = groups.find(inGroupID);
+			if (group == groups.end())
+				return false;
+			while (!group->second.members.empty()) {
+				LeaveGroup(inGroupID, group->second.members.back());
+			}
+			groups.erase(group);
+			return true;
+		}
+
+		/* Get a group's ID from its name - returns 0 if no such group exists */
+		CrossGroupID GetGroupID(const std::string& inGroupName) const
+		{
+			for (auto it = groups.begin(); it != groups.end(); it++) {
+				if (it->second.name == inGroupName)
+					return it->first;
+			}
+			return 0;
+		}
+
+		/* Get a group from its ID - returns nullptr if no such group exists */
+		const CrossClientGroup* GetGroup(const CrossGroupID& inGroupID) const
+		{
+			auto group = groups.find(inGroupID);
+			if (group != groups.end())
+				return &group->second;
+			return nullptr;
+		}
+
+		/* Add a client to a group - returns false if the group doesn't exist or the client isn't connected */
+		bool JoinGroup(const CrossGroupID& inGroupID, CrossClientEntryPtr inClient)
+		{
+			auto group = groups.find(inGroupID);
+			if (group == groups.end() || !inClient || !inClient->IsRunning())
+				return false;
+			if (IsInGroup(inGroupID, inClient))
+				return true;
+			CrossGroupMembership membership;
+			membership.groupID = inGroupID;
+			membership.memberIndex = group->second.members.size();
+			group->second.members.push_back(inClient);
+			inClient->groups.push_back(membership);
+			return true;
+		}
+
+		/* Remove a client from a group - returns false if the client wasn't in the group */
+		bool LeaveGroup(const CrossGroupID& inGroupID, CrossClientEntryPtr inClient)
+		{
+			if (!inClient)
+				return false;
+			for (size_t g = 0; g < inClient->groups.size(); g++) {
+				if (inClient->groups[g].groupID == inGroupID) {
+					std::vector<CrossClientEntryPtr>& members = groups[inGroupID].members;
+					size_t memberIndex = inClient->groups[g].memberIndex;
+
+					/* swap the last member into this slot to keep the list dense */
+					if (memberIndex != members.size() - 1) {
+						CrossClientEntryPtr movedClient = members.back();
+						members[memberIndex] = movedClient;
+						for (size_t m = 0; m < movedClient->groups.size(); m++) {
+							if (movedClient->groups[m].groupID == inGroupID) {
+								movedClient->groups[m].memberIndex = memberIndex;
+								break;
+							}
+						}
+					}
+					members.pop_back();
+					inClient->groups[g] = inClient->groups.back();
+					inClient->groups.pop_back();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/* Returns true if the client is a member of the given group - false otherwise */
+		bool IsInGroup(const CrossGroupID& inGroupID, const CrossClientEntryPtr inClient) const
+		{
+			if (inClient) {
+				for (size_t g = 0; g < inClient->groups.size(); g++) {
+					if (inClient->groups[g].groupID == inGroupID)
+						return true;
+				}
+			}
+			return false;
+		}
+
+		/* Send a packet reliably to all clients in a group */
+		void SendToGroup(const CrossGroupID& inGroupID, const CrossPackPtr inPack, const bool inShouldBlockUntilSent = true) const
+		{
+			return SendToGroup(inGroupID, inPack.get(), inShouldBlockUntilSent);
+		}
+
+		/* Send a packet reliably to all clients in a group */
+		void SendToGroup(const CrossGroupID& inGroupID, const CrossPack* inPack, const bool inShouldBlockUntilSent = true) const
+		{
+			auto group = groups.find(inGroupID);
+			if (group == groups.end())
+				return;
+
+			/* the packet is serialized once and shared by every member */
+			std::shared_ptr<CrossPackData> sharedData = ShareForZeroCopy(inPack);
+			const std::vector<CrossClientEntryPtr>& members = group->second.members;
+			for (size_t m = 0; m < members.size(); m++) {
+				int result;
+				if (members[m]->state != CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED && PassesShaping(inPack, members[m], NetTransMethod::TCP, result)) {
+					TransmitToClient(inPack, members[m], inShouldBlockUntilSent, sharedData);
+				}
+			}
+		}
+
+		/* Send a packet unreliably to all clients in a group. WARNING: Will finalize the packet automatically */
+		void StreamToGroup(const CrossGroupID& inGroupID, const CrossPackPtr inPack, const bool inShouldBlockUntilSent = true) const
+		{
+			return StreamToGroup(inGroupID, inPack.get(), inShouldBlockUntilSent);
+		}
+
+		/* Send a packet unreliably to all clients in a group. WARNING: Will finalize the packet automatically */
+		void StreamToGroup(const CrossGroupID& inGroupID, const CrossPack* inPack, const bool inShouldBlockUntilSent = true) const
+		{
+			auto group = groups.find(inGroupID);
+			if (group == groups.end() || !streamIsBound)
+				return;
+
+			/* finalize if necessary */
+			if (!inPack->IsFinalized()) {
+				inPack->Finalize(false, true, GetServerID());
+			}
+
+			/* gather the member addresses and hand them to the kernel in batches */
+			const std::vector<CrossClientEntryPtr>& members = group->second.members;
+			streamTargets.clear();
+			streamTargetChecksums.clear();
+			for (size_t m = 0; m < members.size(); m++) {
+				int result;
+				if (members[m]->state != CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED && PassesShaping(inPack, members[m], NetTransMethod::UDP, result)) {
+					streamTargets.push_back(members[m]->address);
+					streamTargetChecksums.push_back(members[m]->checksumType);
+				}
+			}
+			TransmitStreamToTargets(inPack, inShouldBlockUntilSent);
+		}
+
+		/* Limit a client's outbound bandwidth of custom data (in bytes per second) - a rate of 0 removes the limit */
+		void SetClientBandwidthLimit(CrossClientEntryPtr inClient, double inBytesPerSecond, double inBurstBytes = 0.0)
+		{
+			if (inClient) {
+				/* the burst must fit at least one packet or queued packets would never be sent */
+				double minBurst = CrossPack::GetMaxPacketSize();
+				inClient->sendBucket.SetRate(inBytesPerSecond, inBurstBytes > minBurst ? inBurstBytes : minBurst, tickTime);
+			}
+		}
+
+		/*
+		 * Limit the outbound bandwidth of a data type to each client (in bytes per second) - packets
+		 * over budget are queued or dropped according to the given policy, and a rate of 0 removes the
+		 * limit. Returns false if the data name is unknown.
+		 */
+		bool SetDataBandwidthLimit(std::string inDataName, double inBytesPerSecond, double inBurstBytes = 0.0, CrossShapingPolicy inPolicy = CrossShapingPolicy::SHAPING_QUEUE)
+		{
+			CrossPackDataID dataID = GetDataIDFromName(inDataName);
+			if (dataID == StaticDataID::UNKNOWN_PACK)
+				return false;
+
+			if (inBytesPerSecond > 0.0) {
+				double minBurst = CrossPack::GetMaxPacketSize();
+				CrossDataShaping shaping;
+				shaping.bytesPerSecond = inBytesPerSecond;
+				shaping.burstBytes = inBurstBytes > minBurst ? inBurstBytes : minBurst;
+				shaping.policy = inPolicy;
+				dataShapings[dataID] = shaping;
+			}
+			else {
+				dataShapings.erase(dataID);
+			}
+
+			/* clients pick up the new limit the next time this data is sent */
+			for (auto it = connectedClients.begin(); it != connectedClients.end(); it++) {
+				if (it->second)
+					it->second->dataSendBuckets.erase(dataID);
+			}
+			return true;
+		}
+
+		/* Adds a rule to the end of the receive filter - returns the rule's index */
+		size_t AddReceiveFilterRule(const CrossReceiveFilterRule& inRule)
+		{
+			receiveFilter.push_back(inRule);
+			receiveFilterSources.push_back(CrossFilterSources());
+			return receiveFilter.size() - 1;
+		}
+
+		/* Removes every rule of the receive filter */
+		void ClearReceiveFilter()
+		{
+			receiveFilter.clear();
+			receiveFilterSources.clear();
+		}
+
+		/* Get the number of rules in the receive filter */
+		size_t GetNumReceiveFilterRules() const
+		{
+			return receiveFilter.size();
+		}
+
+		/* Get a rule of the receive filter, including its counters */
+		const CrossReceiveFilterRule& GetReceiveFilterRule(size_t inIndex) const
+		{
+			return receiveFilter[inIndex];
+		}
+
+		/* Get the receive filter's counters */
+		const CrossReceiveFilterStats& GetReceiveFilterStats() const
+		{
+			return receiveFilterStats;
+		}
+
+		/* Resets the receive filter's counters and those of each rule */
+		void ResetReceiveFilterStats()
+		{
+			receiveFilterStats = CrossReceiveFilterStats();
+			for (size_t r = 0; r < receiveFilter.size(); r++) {
+				receiveFilter[r].matchedPackets = 0;
+				receiveFilter[r].matchedBytes = 0;
+			}
+		}
+
+		/* Get the time (in ms) cached at the start of the most recent update step */
+		double GetTickTime() const
+		{
+			return tickTime;
+		}
+
+		/* Sends every client's aggregated unreliable packets now instead of at the end of the update */
+		void FlushStreams(const bool inShouldBlockUntilSent = true) const
+		{
+			for (size_t c = 0; c < pendingAggregates.size(); c++) {
+				FlushStreamAggregate(pendingAggregates[c], inShouldBlockUntilSent);
+			}
+			pendingAggregates.clear();
+		}
+
+		/* Get the server's listen socket used to connect new clients */
+		TCPSocketPtr GetListenSocket() const
+		{
+			return listenSocket;
+		}
+
+		/* Get the server's stream socket used to transmit and receive UDP packets */
+		UDPSocketPtr GetStreamSocket() const
 		{
 			return streamSocket;
 		}
 
+		/* Get the number of bound stream sockets sharing the server's port - see numStreamShards */
+		size_t GetNumStreamShards() const
+		{
+			return streamShards.size();
+		}
+
+		/* Get one of the stream sockets sharing the server's port - the first is the stream socket */
+		UDPSocketPtr GetStreamShardSocket(size_t inShard) const
+		{
+			if (inShard >= streamShards.size())
+				return nullptr;
+			return streamShards[inShard];
+		}
+
+		/* Get the index of the stream socket a client's datagrams are steered to */
+		size_t GetStreamShard(CrossClientID inClientID) const
+		{
+			if (streamShards.size() <= 1)
+				return 0;
+			return (inClientID & 0xFFFF) % streamShards.size();
+		}
+
 		uint16_t GetPort() const
 		{
 			return port;
@@ -912,6 +1847,37 @@ namespace CrossSock {
 			return false;
 		}
 
+		/*
+		 * Add a message handler for the given custom data - the event will fire with every message of this data's type
+		 * received from a client, whether it was sent as a single packet or reassembled from fragments
+		 */
+		bool AddMessageHandler(std::string inDataName, void(*inFunction)(const CrossMessage*, CrossClientEntryPtr, NetTransMethod))
+		{
+			CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>* messageEvent = GetMessageEvent(inDataName);
+			if (!messageEvent)
+				return false;
+			messageEvent->AddCallback(inFunction);
+			return true;
+		}
+
+		/*
+		 * Add a message handler for the given custom data - the event will fire on the given object (of type Class) with every
+		 * message of this data's type received from a client, whether it was sent as a single packet or reassembled from fragments
+		 */
+		template <class Class>
+		bool AddMessageHandler(std::string inDataName, void(Class::*inFunction)(const CrossMessage*, CrossClientEntryPtr, NetTransMethod), Class* object)
+		{
+			/* Return failure if the object is a nullptr */
+			if (object == nullptr)
+				return false;
+
+			CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>* messageEvent = GetMessageEvent(inDataName);
+			if (!messageEvent)
+				return false;
+			messageEvent->AddObjectCallback<Class>(inFunction, object);
+			return true;
+		}
+
 		/* Add an address to the blacklist so that it can no longer connect to the server */
 		void AddAddressToBlacklist(const CrossSockAddress& inAddress)
 		{
@@ -954,15 +1920,27 @@ namespace CrossSock {
 					}
 				}
 
-				// disconnect this client
-				CrossPack pack;
-				pack.SetDataID(StaticDataID::DISCONNECT_PACK);
-				SendToClient(&pack, inClient);
+				// leave all groups
+				while (!inClient->groups.empty()) {
+					LeaveGroup(inClient->groups.back().groupID, inClient);
+				}
+
+				// drop packets waiting for bandwidth budget
+				inClient->shapedQueue.clear();
+				inClient->dataSendBuckets.clear();
+				inClient->fragmenter.Clear(messageBufferPool);
+				inClient->reassembler.Clear(messageBufferPool);
+				if (inClient->streamAggregate)
+					inClient->streamAggregate->ClearPayload();
+
+				// disconnect this client - the disconnect packet is finished by later updates if the send buffer is full
 				inClient->state = CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED;
 				if (disconnectEvent && disconnectEvent->IsValid())
 					disconnectEvent->Execute(inClient);
 				if (inClient->socket) {
-					inClient->socket->Close();
+					CrossPack pack;
+					pack.SetDataID(StaticDataID::DISCONNECT_PACK);
+					CloseClientSocket(inClient, &pack);
 					inClient->socket.reset();
 				}
 			}
@@ -1036,7 +2014,13 @@ namespace CrossSock {
 		/* Create an empty packet with the given data name */
 		CrossPackPtr CreatePack(std::string inDataName) const
 		{
-			return std::make_shared<CrossPack>(GetDataIDFromName(inDataName));
+			return CrossPackPool::Acquire(GetDataIDFromName(inDataName));
+		}
+
+		/* Create an empty packet with the given data name and a single owner - it can be moved into SendToClient or StreamToClient */
+		CrossPackUniquePtr CreateUniquePack(std::string inDataName) const
+		{
+			return CrossPackPool::AcquireUnique(GetDataIDFromName(inDataName));
 		}
 
 		/* Returns true if the server is not disconnected - false otherwise */
@@ -1063,6 +2047,12 @@ namespace CrossSock {
 			return 0;
 		}
 
+		/* Returns the checksum algorithm offered to clients - packets streamed to a client are switched to the one it accepted (see CrossClientEntry::GetChecksumType) */
+		CrossChecksumType GetChecksumType() const
+		{
+			return serverProperties.checksumType;
+		}
+
 		/*
 		* CrossSock delegates are ugly - see CrossUtil.h for an explanation
 		*/
@@ -1151,6 +2141,15 @@ namespace CrossSock {
 			bindEvent = newEvent;
 		}
 
+		/* Set the server drained handler - called once a drained server has stopped */
+		void SetServerDrainedHandler(void(*inFunction)())
+		{
+			delete drainedEvent;
+			CrossSingleEvent<void>* newEvent = new CrossSingleEvent<void>();
+			newEvent->SetCallback(inFunction);
+			drainedEvent = newEvent;
+		}
+
 		/* Set the client validation handler - clients are only connected if this handler returns true.  By default all clients are connected */
 		void SetClientValidationHandler(bool(*inFunction)(CrossClientEntryPtr))
 		{
@@ -1271,6 +2270,16 @@ namespace CrossSock {
 			bindEvent = newEvent;
 		}
 
+		/* Set the server drained handler - called once a drained server has stopped */
+		template <class Class>
+		void SetServerDrainedHandler(void(Class::*inFunction)(), Class* object)
+		{
+			delete drainedEvent;
+			CrossObjectEvent<Class, void>* newEvent = new CrossObjectEvent<Class, void>();
+			newEvent->SetCallback(inFunction, object);
+			drainedEvent = newEvent;
+		}
+
 		/* Set the client validation handler - clients are only connected if this handler returns true.  By default all clients are connected */
 		template <class Class>
 		void SetClientValidationHandler(bool(Class::*inFunction)(CrossClientEntryPtr), Class* object)
@@ -1313,6 +2322,9 @@ namespace CrossSock {
 		std::vector<CrossDataEvent<const CrossPack*, CrossClientEntryPtr, NetTransMethod>*> dataEvents;
 		std::unordered_map<CrossPackDataID, CrossDataEvent<const CrossPack*, CrossClientEntryPtr, NetTransMethod>*> dataEventsByID;
 		std::unordered_map<std::string, CrossDataEvent<const CrossPack*, CrossClientEntryPtr, NetTransMethod>*> dataEventsByName;
+		std::vector<CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>*> messageEvents;
+		std::unordered_map<CrossPackDataID, CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>*> messageEventsByID;
+		CrossMessageBufferPool messageBufferPool;
 		CrossServerProperties serverProperties;
 		CrossServerState serverState;
 		CrossEvent<void, CrossClientEntryPtr>* connectEvent;
@@ -1324,21 +2336,43 @@ namespace CrossSock {
 		CrossEvent<void, CrossClientEntryPtr>* destroyClientEvent;
 		CrossEvent<void, CrossClientEntryPtr>* initializeClientEvent;
 		CrossEvent<void>* bindEvent;
+		CrossEvent<void>* drainedEvent;
 		CrossEvent<bool, CrossClientEntryPtr>* validateEvent;
 		CrossEvent<void, const CrossPack*, CrossClientEntryPtr, NetTransMethod>* receiveEvent;
 		CrossEvent<void, const CrossPack*, CrossClientEntryPtr, NetTransMethod, NetTransError>* transErrorEvent;
 		std::unordered_map<CrossSockAddress, bool> canConnectList;
+		std::unordered_map<CrossPackDataID, CrossDataShaping> dataShapings;
+		std::vector<CrossReceiveFilterRule> receiveFilter;
+		std::vector<CrossFilterSources> receiveFilterSources;
+		CrossReceiveFilterStats receiveFilterStats;
+		std::unordered_map<CrossGroupID, CrossClientGroup> groups;
+		CrossGroupID nextAvailableGroupID;
+		mutable std::vector<CrossSockAddress> streamTargets;
+		mutable std::vector<CrossChecksumType> streamTargetChecksums;
+		mutable std::vector<CrossSockAddress> streamChecksumTargets;
+		mutable std::vector<const CrossPack*> streamBatchPacks;
+		mutable std::vector<CrossPackData> streamBatchBuffer;
+		mutable std::vector<CrossClientEntryPtr> pendingAggregates;
+		CrossTimer serverClock;
+		double tickTime;
+		double drainDeadline;
+		std::vector<CrossClosingSocket> closingSockets;
 		bool streamIsBound;
-		CrossPackData udpBuffer[CROSS_SOCK_BUFFER_SIZE];
-		CrossBufferLen udpBufferLength;
+		std::vector<UDPSocketPtr> streamShards;
+		int64_t receiveTime;
+		size_t nextStreamShard;
+		std::vector<CrossPackData> udpDatagramData;
+		std::vector<CrossDatagram> udpDatagrams;
+		CrossRingBufferPtr tcpScratchBuffer;
+		CrossRingBufferPool tcpBufferPool;
+		size_t tcpTotalBacklog;
 		CrossTimer alivenessTestTimer;
 
 		/*
-		 * receive function for when raw data is received - this is where the majority of
-		 * the connection process is implemented. In addition, this function is responsible
-		 * for calling custom data events.
+		 * receive function for when raw data is received - frames the next packet in the
+		 * data and returns the number of bytes it used
 		 */
-		CrossBufferLen OnReceiveNewData(CrossPackData* inData, CrossBufferLen inLength, CrossClientEntryPtr inClient, NetTransMethod inMethod) {
+		CrossBufferLen OnReceiveNewData(CrossPackData* inData, CrossBufferLen inLength, CrossClientEntryPtr inClient, NetTransMethod inMethod, const CrossSockAddress* inFromAddress = nullptr) {
 			if (inLength >= CrossPack::GetHeaderSize()) {
 				CrossPackHeader header = CrossPack::PeakHeader(inData);
 				if (header.payloadSize > CrossPack::MAX_PAYLOAD_BYTES) {
@@ -1346,180 +2380,876 @@ namespace CrossSock {
 						transErrorEvent->Execute(nullptr, inClient, inMethod, NetTransError::INVALID_PAYLOAD_SIZE);
 					return inLength;
 				}
-				if (header.payloadSize + CrossPack::GetHeaderSize() + CrossPack::GetFooterLength(header) <= inLength) {
+				CrossBufferLen packetSize = header.payloadSize + CrossPack::GetHeaderSize() + CrossPack::GetFooterLength(header);
+				if (packetSize <= inLength) {
+
+					/* drop filtered packets before anything is built for them */
+					if (!receiveFilter.empty() && !PassesReceiveFilter(header, inData, packetSize, inClient, inMethod, inFromAddress))
+						return packetSize;
+
 					CrossPackFooter footer = CrossPack::PeakFooter(inData, header);
 					CrossPack inPack(header, footer, inData);
+					inPack.SetReceiveTime(receiveTime);
 					if (inMethod == NetTransMethod::UDP && inPack.GetPacketFlag(CrossPackFlagBit::UDP_SUPPORT_FLAG)) {
 						inClient = GetClientEntry(inPack.GetSenderID());
+						if (inClient && inFromAddress)
+							inClient->streamAddress = *inFromAddress;
 					}
-					if (inPack.GetDataID() == StaticDataID::HANDSHAKE && inClient) {
-						if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE) {
-							inClient->state = CrossClientEntryState::CLIENT_ENTRY_CONNECTED;
-							if (readyEvent && readyEvent->IsValid())
-								readyEvent->Execute(inClient);
-						}
+					if (inPack.GetDataID() == StaticDataID::AGGREGATE_PACK) {
+						OnReceiveAggregate(inPack, inData, inClient, inMethod);
 					}
-					else if (inPack.GetDataID() == StaticDataID::INIT_CLIENT_ID && inClient) {
-
-						// reset timeout
-						inClient->ResetTimeout(CROSS_SOCK_MAX_TIMEOUT);
-
-						// send aliveness test
-						CrossPack alivenessTest;
-						alivenessTest.SetDataID(StaticDataID::ALIVENESS_TEST);
-						alivenessTest.AddToPayload<float>((float)((serverProperties.alivenessTestDelay + inClient->GetPing()) * CROSS_SOCK_TIMEOUT_FACTOR));
-						SendToClient(&alivenessTest, inClient);
-
-						CrossPack pack;
-						pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
-						pack.AddToPayload<CrossClientID>(inClient->clientID);
-						SendToClient(&pack, inClient);
-						if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_INIT)
-							inClient->state = CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE;
-
-						/* execute callbacks */
-						if (connectEvent && connectEvent->IsValid())
-							connectEvent->Execute(inClient);
+					else {
+						OnReceivePack(inPack, inClient, inMethod);
+					}
+
+					/* return packet size */
+					return inPack.GetPacketSize();
+				}
+			}
+
+			/* return 0 - no buffer data used */
+			return 0;
+		}
+
+		/* Moves a client's unread TCP data into a pooled buffer that holds at least the given number of bytes */
+		void MoveReceiveBuffer(const CrossClientEntryPtr& inClient, CrossRingBuffer& inFrom, size_t inMinCapacity)
+		{
+			if (inMinCapacity < inFrom.GetSize())
+				inMinCapacity = inFrom.GetSize();
+			inClient->tcpBuffer = tcpBufferPool.Acquire(inMinCapacity);
+			memcpy(inClient->tcpBuffer->GetWritePtr(), inFrom.GetReadPtr(), inFrom.GetSize());
+			inClient->tcpBuffer->Commit(inFrom.GetSize());
+		}
+
+		/* Copies a packet into a buffer shared by zero-copy sends - returns nullptr if the packet is too small for zero-copy */
+		std::shared_ptr<CrossPackData> ShareForZeroCopy(const CrossPack* inPack) const
+		{
+			CrossPackPayloadLen packetSize = inPack->GetPacketSize();
+			if (serverProperties.zeroCopySendThreshold <= 0 || packetSize < serverProperties.zeroCopySendThreshold)
+				return nullptr;
+			std::shared_ptr<CrossPackData> sharedData(new CrossPackData[packetSize], std::default_delete<CrossPackData[]>());
+			memcpy(sharedData.get(), inPack->Serialize(), packetSize);
+			return sharedData;
+		}
+
+		/*
+		 * Send a packet reliably to a client without bandwidth shaping - uses the shared data for a zero-copy send if given.
+		 * Returns the number of bytes sent, which is less than the packet size if a non-blocking send was cut short
+		 */
+		int TransmitToClient(const CrossPack* inPack, const CrossClientEntryPtr& inClient, const bool inShouldBlockUntilSent, const std::shared_ptr<CrossPackData>& inSharedData = nullptr) const
+		{
+			/* the rest of a packet that was cut short must go first, or the stream would be corrupted */
+			if (!inClient->sendTail.empty() && !FlushSendTail(inClient, inShouldBlockUntilSent))
+				return SOCKET_ERROR;
+
+			const CrossPackData* data = inSharedData ? inSharedData.get() : inPack->Serialize();
+			int packetSize = inPack->GetPacketSize();
+
+			/* send until every byte is out */
+			int sent = 0;
+			int result;
+			do {
+				if (inSharedData)
+					result = inClient->socket->SendZeroCopy(data + sent, packetSize - sent, inSharedData);
+				else
+					result = inClient->socket->Send(data + sent, packetSize - sent);
+				if (result > 0)
+					sent += result;
+			} while (inShouldBlockUntilSent && sent < packetSize && (result > 0 || CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK));
+			return (sent > 0) ? sent : result;
+		}
+
+		/* Send a finalized packet unreliably to a client without bandwidth shaping */
+		int TransmitStreamToClient(const CrossPack* inPack, const CrossClientEntryPtr& inClient, const bool inShouldBlockUntilSent) const
+		{
+			/* send until succesful */
+			int result;
+			do {
+				result = streamSocket->SendTo(inPack->Serialize(), inPack->GetPacketSize(), inClient->address);
+			} while (inShouldBlockUntilSent && result < 0 && CrossSockUtil::GetLastError() == CrossSockError::WOULDBLOCK);
+			return result;
+		}
+
+		/*
+		 * Appends a finalized packet to a client's aggregate datagram - the packet is
+		 * stored without its sender ID, and the aggregate is sent first if the packet
+		 * doesn't fit. Returns the number of bytes queued.
+		 */
+		int AggregateStreamToClient(const CrossPack* inPack, const CrossClientEntryPtr& inClient, const bool inShouldBlockUntilSent) const
+		{
+			int aggregateLimit = serverProperties.streamAggregateSize - CrossPack::GetHeaderSize() - (int)sizeof(CrossClientID);
+			if (aggregateLimit > (int)CrossPack::MAX_PAYLOAD_BYTES)
+				aggregateLimit = CrossPack::MAX_PAYLOAD_BYTES;
+
+			/* packets that can't share a datagram are sent on their own - after any earlier packets */
+			int senderSize = inPack->GetPacketFlag(CrossPackFlagBit::UDP_SUPPORT_FLAG) ? sizeof(CrossClientID) : 0;
+			int packetSize = inPack->GetPacketSize() - senderSize;
+			if (packetSize > aggregateLimit) {
+				if (inClient->streamAggregate && inClient->streamAggregate->GetPayloadSize() > 0)
+					FlushStreamAggregate(inClient, inShouldBlockUntilSent);
+				return TransmitStreamToClient(inPack, inClient, inShouldBlockUntilSent);
+			}
+
+			if (!inClient->streamAggregate)
+				inClient->streamAggregate = CrossPackPool::Acquire(StaticDataID::AGGREGATE_PACK);
+			CrossPack* aggregate = inClient->streamAggregate.get();
+			if (aggregate->GetPayloadSize() + packetSize > aggregateLimit)
+				FlushStreamAggregate(inClient, inShouldBlockUntilSent);
+			if (aggregate->GetPayloadSize() == 0)
+				pendingAggregates.push_back(inClient);
+
+			/* copy the header with the sender ID flag cleared, then the payload and checksum */
+			const CrossPackData* data = inPack->Serialize();
+			CrossPackData header[sizeof(CrossPackHeader)];
+			memcpy(header, data, CrossPack::GetHeaderSize());
+			const int flagsPos = sizeof(CrossPackDataID) + sizeof(CrossPackPayloadLen);
+			header[flagsPos] = CrossSysUtil::ClearBit(header[flagsPos], CrossPackFlagBit::UDP_SUPPORT_FLAG);
+			aggregate->AddDataToPayload(header, CrossPack::GetHeaderSize());
+			aggregate->AddDataToPayload(data + CrossPack::GetHeaderSize(), packetSize - CrossPack::GetHeaderSize());
+			return packetSize;
+		}
+
+		/* Sends a client's aggregate datagram if it holds any packets */
+		void FlushStreamAggregate(const CrossClientEntryPtr& inClient, const bool inShouldBlockUntilSent) const
+		{
+			CrossPack* aggregate = inClient->streamAggregate.get();
+			if (!aggregate || aggregate->GetPayloadSize() == 0)
+				return;
+			if (streamIsBound && inClient->IsRunning()) {
+				aggregate->Finalize(false, true, GetServerID());
+				TransmitStreamToClient(aggregate, inClient, inShouldBlockUntilSent);
+			}
+			aggregate->ClearPayload();
+		}
+
+		/* Send a finalized packet unreliably to many addresses using batched sends */
+		void TransmitStreamToMany(const CrossPack* inPack, const std::vector<CrossSockAddress>& inAddresses, const bool inShouldBlockUntilSent) const
+		{
+			int sent = 0;
+			int numAddresses = (int)inAddresses.size();
+			while (sent < numAddresses) {
+				int result = streamSocket->SendToMany(inPack->Serialize(), inPack->GetPacketSize(), inAddresses.data() + sent, numAddresses - sent);
+				if (result > 0)
+					sent += result;
+				else if (!inShouldBlockUntilSent || CrossSockUtil::GetLastError() != CrossSockError::WOULDBLOCK)
+					sent++; /* skip the address that failed */
+			}
+		}
+
+		/*
+		 * Send a finalized packet unreliably to the gathered stream targets - targets that check another checksum
+		 * algorithm than the packet's get a copy refinalized with theirs, and the packet is restored afterwards
+		 */
+		void TransmitStreamToTargets(const CrossPack* inPack, const bool inShouldBlockUntilSent) const
+		{
+			CrossChecksumType packChecksumType = inPack->GetChecksumType();
+			bool isMixed = false;
+			for (size_t t = 0; t < streamTargetChecksums.size() && !isMixed; t++)
+				isMixed = ChecksumDiffers(inPack, streamTargetChecksums[t]);
+			if (!isMixed) {
+				TransmitStreamToMany(inPack, streamTargets, inShouldBlockUntilSent);
+				return;
+			}
+
+			/* send to the targets of each algorithm in turn */
+			for (int type = CrossChecksumType::CHECKSUM_SUM; type < CrossChecksumType::CHECKSUM_NONE; type++) {
+				streamChecksumTargets.clear();
+				for (size_t t = 0; t < streamTargets.size(); t++) {
+					CrossChecksumType targetType = (streamTargetChecksums[t] != CrossChecksumType::CHECKSUM_NONE) ? streamTargetChecksums[t] : packChecksumType;
+					if (targetType == type)
+						streamChecksumTargets.push_back(streamTargets[t]);
+				}
+				if (streamChecksumTargets.empty())
+					continue;
+				inPack->SetChecksumType((CrossChecksumType)type);
+				TransmitStreamToMany(inPack, streamChecksumTargets, inShouldBlockUntilSent);
+			}
+			inPack->SetChecksumType(packChecksumType);
+		}
+
+		/* Returns true if a packet must be refinalized for a client that checks the given checksum algorithm */
+		static bool ChecksumDiffers(const CrossPack* inPack, CrossChecksumType inChecksumType)
+		{
+			return inPack->GetPacketFlag(CrossPackFlagBit::CHECKSUM_FLAG) && inChecksumType != CrossChecksumType::CHECKSUM_NONE && inPack->GetChecksumType() != inChecksumType;
+		}
+
+		/* Reads the checksum algorithm a client accepted from its handshake reply - clients that send none use the byte sum */
+		static CrossChecksumType ReadChecksumType(const CrossPack& inPack)
+		{
+			unsigned char checksumType = inPack.RemoveFromPayload<unsigned char>();
+			return (checksumType <= CrossChecksumType::CHECKSUM_NONE) ? (CrossChecksumType)checksumType : CrossChecksumType::CHECKSUM_SUM;
+		}
+
+		/* Gets a client's send bucket for a data type, and the type's limit - both are nullptr if the type isn't shaped */
+		CrossTokenBucket* GetDataSendBucket(CrossPackDataID inDataID, const CrossClientEntryPtr& inClient, const CrossDataShaping*& outShaping) const
+		{
+			outShaping = nullptr;
+			if (dataShapings.empty())
+				return nullptr;
+			auto shaping = dataShapings.find(inDataID);
+			if (shaping == dataShapings.end())
+				return nullptr;
+			outShaping = &shaping->second;
+
+			auto bucket = inClient->dataSendBuckets.find(inDataID);
+			if (bucket == inClient->dataSendBuckets.end())
+				bucket = inClient->dataSendBuckets.insert(std::make_pair(inDataID, CrossTokenBucket(outShaping->bytesPerSecond, outShaping->burstBytes, tickTime))).first;
+			return &bucket->second;
+		}
+
+		/*
+		 * Applies bandwidth shaping to a packet about to be sent to a client - returns true if the
+		 * packet may be sent now. Otherwise the packet has been queued (outResult is 0) or dropped
+		 * (outResult is BANDWIDTH_EXCEEDED). Control packets are never shaped. A queued packet is moved
+		 * out of inMovablePack if given, and copied otherwise.
+		 */
+		bool PassesShaping(const CrossPack* inPack, const CrossClientEntryPtr& inClient, NetTransMethod inMethod, int& outResult, CrossPack* inMovablePack = nullptr) const
+		{
+			CrossPackDataID dataID = inPack->GetDataID();
+			if (dataID < StaticDataID::CUSTOM_DATA_START)
+				return true;
+
+			/* find this data type's limit */
+			const CrossDataShaping* dataShaping = nullptr;
+			CrossTokenBucket* dataBucket = GetDataSendBucket(dataID, inClient, dataShaping);
+			if (!dataShaping && !inClient->sendBucket.IsLimited())
+				return true;
+
+			/* send now if within budget - queued packets must not be overtaken by packets that can wait */
+			CrossShapingPolicy policy = dataShaping ? dataShaping->policy : CrossShapingPolicy::SHAPING_QUEUE;
+			double packetSize = inPack->GetPacketSize();
+			bool mustWait = (policy == CrossShapingPolicy::SHAPING_QUEUE && !inClient->shapedQueue.empty());
+			if (!mustWait && inClient->sendBucket.CanConsume(packetSize, tickTime) && (!dataBucket || dataBucket->CanConsume(packetSize, tickTime))) {
+				inClient->sendBucket.Consume(packetSize);
+				if (dataBucket)
+					dataBucket->Consume(packetSize);
+				return true;
+			}
+
+			/* otherwise queue or drop */
+			if (policy == CrossShapingPolicy::SHAPING_QUEUE && inClient->shapedQueue.size() < (size_t)serverProperties.maxShapedQueueLength) {
+				CrossShapedPack shaped;
+				shaped.pack = inMovablePack ? CrossPackPool::Acquire(std::move(*inMovablePack)) : CrossPackPool::Acquire(*inPack);
+				shaped.method = inMethod;
+				inClient->shapedQueue.push_back(shaped);
+				outResult = 0;
+			}
+			else {
+				outResult = NetTransError::BANDWIDTH_EXCEEDED;
+			}
+			return false;
+		}
+
+		/* Sends a final packet (after the rest of any packet cut short) without blocking and closes the socket - unsent bytes are kept for FlushClosingSockets */
+		void CloseClientSocket(const CrossClientEntryPtr& inClient, const CrossPack* inPack)
+		{
+			CrossClosingSocket closing;
+			closing.socket = inClient->socket;
+			closing.pending.swap(inClient->sendTail);
+			closing.pending.insert(closing.pending.end(), inPack->Serialize(), inPack->Serialize() + inPack->GetPacketSize());
+			int result = closing.socket->Send(closing.pending.data(), (int)closing.pending.size());
+			if (result == (int)closing.pending.size() || (result < 0 && CrossSockUtil::GetLastError() != CrossSockError::WOULDBLOCK) || !IsRunning()) {
+				closing.socket->Close();
+				return;
+			}
+			closing.bytesSent = result > 0 ? result : 0;
+			closing.deadline = serverClock.GetElapsedTime() + serverProperties.disconnectSendTimeout;
+			closingSockets.push_back(closing);
+		}
+
+		/* Sends the remaining bytes of each closing socket without blocking - closes sockets that are done or out of time */
+		void FlushClosingSockets()
+		{
+			size_t c = 0;
+			while (c < closingSockets.size()) {
+				CrossClosingSocket& closing = closingSockets[c];
+				int result = closing.socket->Send(closing.pending.data() + closing.bytesSent, (int)(closing.pending.size() - closing.bytesSent));
+				if (result > 0)
+					closing.bytesSent += result;
+				bool failed = result < 0 && CrossSockUtil::GetLastError() != CrossSockError::WOULDBLOCK;
+				if (closing.bytesSent >= closing.pending.size() || failed || tickTime >= closing.deadline) {
+					closing.socket->Close();
+					closingSockets[c] = closingSockets.back();
+					closingSockets.pop_back();
+				}
+				else {
+					c++;
+				}
+			}
+		}
+
+		/* Sends a client's queued packets in order while its bandwidth budget allows */
+		void FlushShapedPacks(const CrossClientEntryPtr& inClient)
+		{
+			while (!inClient->shapedQueue.empty()) {
+				CrossShapedPack& shaped = inClient->shapedQueue.front();
+				double packetSize = shaped.pack->GetPacketSize();
+
+				CrossTokenBucket* dataBucket = nullptr;
+				auto bucket = inClient->dataSendBuckets.find(shaped.pack->GetDataID());
+				if (bucket != inClient->dataSendBuckets.end())
+					dataBucket = &bucket->second;
+
+				if (!inClient->sendBucket.CanConsume(packetSize, tickTime) || (dataBucket && !dataBucket->CanConsume(packetSize, tickTime)))
+					break;
+				inClient->sendBucket.Consume(packetSize);
+				if (dataBucket)
+					dataBucket->Consume(packetSize);
+
+				if (shaped.method == NetTransMethod::TCP)
+					TransmitToClient(shaped.pack.get(), inClient, true);
+				else if (streamIsBound)
+					TransmitStreamToClient(shaped.pack.get(), inClient, true);
+				inClient->shapedQueue.pop_front();
+			}
+		}
+
+		/* Sends a message as a single packet if it fits, or queues it to be sent in fragments */
+		int QueueMessage(CrossPackDataID inDataID, const CrossPackData* inData, uint32_t inSize, const CrossClientEntryPtr& inClient, NetTransMethod inMethod)
+		{
+			if (!inClient || inClient->state == CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED)
+				return NetTransError::CLIENT_NOT_CONNECTED;
+			else if (inMethod == NetTransMethod::UDP && !streamIsBound)
+				return NetTransError::STREAM_NOT_BOUND;
+			else if (inDataID < StaticDataID::CUSTOM_DATA_START)
+				return NetTransError::INVALID_DATA_ID;
+
+			if (inSize <= CrossPack::MAX_PAYLOAD_BYTES) {
+				CrossPack pack(inDataID);
+				pack.AddDataToPayload(inData, (CrossPackPayloadLen)inSize);
+				if (inMethod == NetTransMethod::TCP)
+					return SendToClient(&pack, inClient);
+				return StreamToClient(&pack, inClient);
+			}
+			inClient->fragmenter.Queue(inDataID, inData, inSize, inMethod, messageBufferPool);
+			return (int)inSize;
+		}
+
+		/* Sends the next fragments of a client's queued messages while this update step's fragment budget allows */
+		void FlushFragments(const CrossClientEntryPtr& inClient)
+		{
+			/* packets waiting for bandwidth go first */
+			if (!inClient->shapedQueue.empty())
+				return;
+
+			CrossPack fragment;
+			CrossPackDataID dataID;
+			NetTransMethod method;
+			int bytesSent = 0;
+			while (bytesSent < serverProperties.fragmentBytesPerUpdate && inClient->IsRunning() && inClient->fragmenter.NextFragment(fragment, dataID, method)) {
+
+				/* fragments count against the bandwidth limits of their message's data type - they wait rather than queue */
+				const CrossDataShaping* dataShaping;
+				CrossTokenBucket* dataBucket = GetDataSendBucket(dataID, inClient, dataShaping);
+				double packetSize = fragment.GetPacketSize();
+				if (!inClient->sendBucket.CanConsume(packetSize, tickTime) || (dataBucket && !dataBucket->CanConsume(packetSize, tickTime)))
+					break;
+
+				/* send without blocking - a fragment that doesn't go out is tried again next update */
+				if (method == NetTransMethod::TCP) {
+					int result = TransmitToClient(&fragment, inClient, false);
+					if (result <= 0)
+						break;
+					if (result < fragment.GetPacketSize())
+						inClient->sendTail.assign(fragment.Serialize() + result, fragment.Serialize() + fragment.GetPacketSize());
+				}
+				else if (streamIsBound) {
+					fragment.Finalize(false, true, GetServerID());
+					if (TransmitStreamToClient(&fragment, inClient, false) < 0)
+						break;
+				}
+				else {
+					break;
+				}
+
+				inClient->sendBucket.Consume(packetSize);
+				if (dataBucket)
+					dataBucket->Consume(packetSize);
+				inClient->fragmenter.PopFragment(messageBufferPool);
+				bytesSent += fragment.GetPacketSize();
+				if (!inClient->sendTail.empty())
+					break;
+			}
+		}
+
+		/* Sends a packet reliably without blocking - whatever doesn't fit in the socket is kept and sent before anything else */
+		int QueueToClient(const CrossPack* inPack, const CrossClientEntryPtr& inClient) const
+		{
+			if (!inClient->socket || inClient->state == CrossClientEntryState::CLIENT_ENTRY_DISCONNECTED)
+				return NetTransError::CLIENT_NOT_CONNECTED;
+			int result = 0;
+			if (inClient->sendTail.empty() || FlushSendTail(inClient, false)) {
+				result = TransmitToClient(inPack, inClient, false);
+				if (result < 0 && CrossSockUtil::GetLastError() != CrossSockError::WOULDBLOCK)
+					return result;
+				if (result < 0)
+					result = 0;
+			}
+			else if (CrossSockUtil::GetLastError() != CrossSockError::WOULDBLOCK) {
+				return SOCKET_ERROR;
+			}
+			inClient->sendTail.insert(inClient->sendTail.end(), inPack->Serialize() + result, inPack->Serialize() + inPack->GetPacketSize());
+			return inPack->GetPacketSize();
+		}
+
+		/* Sends what is left of packets that were cut short by a full socket - returns true once nothing is left */
+		bool FlushSendTail(const CrossClientEntryPtr& inClient, const bool inShouldBlockUntilSent) const
+		{
+			std::vector<CrossPackData>& tail = inClient->sendTail;
+			size_t bytesSent = 0;
+			while (bytesSent < tail.size()) {
+				int result = inClient->socket->Send(tail.data() + bytesSent, (int)(tail.size() - bytesSent));
+				if (result > 0)
+					bytesSent += result;
+				else if (!inShouldBlockUntilSent || CrossSockUtil::GetLastError() != CrossSockError::WOULDBLOCK)
+					break;
+			}
+			tail.erase(tail.begin(), tail.begin() + bytesSent);
+			return tail.empty();
+		}
+
+		/* Adds a received fragment to its message, and handles the message once it is whole */
+		void OnReceiveFragment(const CrossPack& inPack, const CrossClientEntryPtr& inClient, NetTransMethod inMethod)
+		{
+			CrossPackDataID dataID;
+			std::vector<CrossPackData> messageData;
+			CrossFragmentResult result = inClient->reassembler.AddFragment(inPack, tickTime, (uint32_t)serverProperties.maxMessageSize, (size_t)serverProperties.maxReassemblyBytes, messageBufferPool, dataID, messageData);
+			if (result == CrossFragmentResult::FRAGMENT_REJECTED) {
+				if (transErrorEvent && transErrorEvent->IsValid())
+					transErrorEvent->Execute(&inPack, inClient, inMethod, NetTransError::INVALID_PAYLOAD_SIZE);
+			}
+			else if (result == CrossFragmentResult::FRAGMENT_COMPLETE) {
+				auto messageEvent = messageEventsByID.find(dataID);
+				if (messageEvent != messageEventsByID.end()) {
+					CrossMessage message(dataID, messageData.data(), (uint32_t)messageData.size(), inPack.GetReceiveTime());
+					OnReceiveMessage(message, messageEvent->second, inClient, inMethod);
+				}
+				else if (transErrorEvent && transErrorEvent->IsValid()) {
+					transErrorEvent->Execute(&inPack, inClient, inMethod, NetTransError::INVALID_DATA_ID);
+				}
+				messageBufferPool.Release(messageData);
+			}
+		}
+
+		/* Calls each callback of a message event until finished or the client is disconnected */
+		void OnReceiveMessage(const CrossMessage& inMessage, CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>* inEvent, const CrossClientEntryPtr& inClient, NetTransMethod inMethod)
+		{
+			for (int c = (int)inEvent->GetNumCallbacks() - 1; c >= 0; c--) {
+				if (!IsRunning() || !inClient || !inClient->IsRunning()) {
+					break;
+				}
+				inEvent->Execute(c, &inMessage, inClient, inMethod);
+			}
+		}
+
+		/* Finds or adds the message event of the given custom data - returns nullptr if the data can't be added at this time */
+		CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>* GetMessageEvent(std::string inDataName)
+		{
+			/* truncate name if too long */
+			if (inDataName.length() > CROSS_SOCK_MAX_DATA_NAME_LENGTH)
+				inDataName.resize(CROSS_SOCK_MAX_DATA_NAME_LENGTH);
+
+			for (size_t m = 0; m < messageEvents.size(); m++) {
+				if (messageEvents[m]->name == inDataName)
+					return messageEvents[m];
+			}
+
+			/* messages share the custom data list - the data is added if necessary */
+			if (!AddDataType(inDataName))
+				return nullptr;
+			for (size_t d = 0; d < dataEvents.size(); d++) {
+				if (dataEvents[d]->name == inDataName) {
+					CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>* newEvent = new CrossDataEvent<const CrossMessage*, CrossClientEntryPtr, NetTransMethod>(inDataName);
+					newEvent->dataID = dataEvents[d]->dataID;
+					messageEvents.push_back(newEvent);
+					messageEventsByID[newEvent->dataID] = newEvent;
+					return newEvent;
+				}
+			}
+			return nullptr;
+		}
+
+		/*
+		 * receive function for a single packet - this is where the majority of the
+		 * connection process is implemented. In addition, this function is responsible
+		 * for calling custom data events.
+		 */
+		void OnReceivePack(const CrossPack& inPack, CrossClientEntryPtr inClient, NetTransMethod inMethod)
+		{
+			if (inPack.GetDataID() == StaticDataID::HANDSHAKE && inClient) {
+				if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE) {
+					inClient->state = CrossClientEntryState::CLIENT_ENTRY_CONNECTED;
+					if (readyEvent && readyEvent->IsValid())
+						readyEvent->Execute(inClient);
+				}
+			}
+			else if (inPack.GetDataID() == StaticDataID::INIT_CLIENT_ID && inClient) {
+				inClient->checksumType = ReadChecksumType(inPack);
+
+				// reset timeout
+				inClient->ResetTimeout(CROSS_SOCK_MAX_TIMEOUT);
+
+				// send aliveness test
+				CrossPack alivenessTest;
+				alivenessTest.SetDataID(StaticDataID::ALIVENESS_TEST);
+				alivenessTest.AddToPayload<float>((float)((serverProperties.alivenessTestDelay + inClient->GetPing()) * CROSS_SOCK_TIMEOUT_FACTOR));
+				SendToClient(&alivenessTest, inClient);
+
+				CrossPack pack;
+				pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
+				pack.AddToPayload<CrossClientID>(inClient->clientID);
+				SendToClient(&pack, inClient);
+				if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_INIT)
+					inClient->state = CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE;
+
+				/* execute callbacks */
+				if (connectEvent && connectEvent->IsValid())
+					connectEvent->Execute(inClient);
+				if (initializeClientEvent && initializeClientEvent->IsValid())
+					initializeClientEvent->Execute(inClient);
+			}
+			else if (inPack.GetDataID() == StaticDataID::DISCONNECT_PACK && inClient) {
+				DisconnectClient(inClient);
+			}
+			else if (inPack.GetDataID() == StaticDataID::RECONNECT_PACK && inClient) {
+
+				// reset timeout
+				inClient->ResetTimeout(CROSS_SOCK_MAX_TIMEOUT);
+
+				// send aliveness test
+				CrossPack alivenessTest;
+				alivenessTest.SetDataID(StaticDataID::ALIVENESS_TEST);
+				alivenessTest.AddToPayload<float>((float)(serverProperties.alivenessTestDelay * CROSS_SOCK_TIMEOUT_FACTOR));
+				SendToClient(&alivenessTest, inClient);
+
+				/* check if we can reconnect */
+				CrossClientID oldID = inPack.RemoveFromPayload<CrossClientID>();
+				inClient->checksumType = ReadChecksumType(inPack);
+				auto client = connectedClients.find(oldID);
+				if (oldID == 0 || client != connectedClients.end()) {
+					CrossPack pack;
+					pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
+					pack.AddToPayload<CrossClientID>(inClient->clientID);
+					SendToClient(&pack, inClient);
+					if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_INIT)
+						inClient->state = CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE;
+
+					/* execute callbacks */
+					if (failedReconnectEvent && failedReconnectEvent->IsValid())
+						failedReconnectEvent->Execute(inClient);
+					if (connectEvent && connectEvent->IsValid())
+						connectEvent->Execute(inClient);
+					if (initializeClientEvent && initializeClientEvent->IsValid())
+						initializeClientEvent->Execute(inClient);
+				}
+				else { // else we can reconnect..
+
+					// erase the client to update its id
+					connectedClients.erase(inClient->clientID);
+
+					// update this clients id and add back to the list
+					inClient->clientID = oldID;
+					connectedClients[oldID] = inClient;
+
+					// try and find the old client in the disconnect list
+					auto oldClient = disconnectedClients.find(oldID);
+					if (oldClient != disconnectedClients.end() && oldClient->second) {
+
+						// copy custom data and delete / remove from the disconnected clients list
+						CrossClientEntryPtr oldClientEntry = oldClient->second;
+						inClient->SetCustomData(oldClientEntry->GetCustomData<void>());
+						disconnectedClients.erase(oldClient);
+						oldClientEntry.reset();
+					}
+					else { // otherwise re-initialize this client
 						if (initializeClientEvent && initializeClientEvent->IsValid())
 							initializeClientEvent->Execute(inClient);
 					}
-					else if (inPack.GetDataID() == StaticDataID::DISCONNECT_PACK && inClient) {
-						DisconnectClient(inClient);
-					}
-					else if (inPack.GetDataID() == StaticDataID::RECONNECT_PACK && inClient) {
-
-						// reset timeout
-						inClient->ResetTimeout(CROSS_SOCK_MAX_TIMEOUT);
-
-						// send aliveness test
-						CrossPack alivenessTest;
-						alivenessTest.SetDataID(StaticDataID::ALIVENESS_TEST);
-						alivenessTest.AddToPayload<float>((float)(serverProperties.alivenessTestDelay * CROSS_SOCK_TIMEOUT_FACTOR));
-						SendToClient(&alivenessTest, inClient);
-
-						/* check if we can reconnect */
-						CrossClientID oldID = inPack.RemoveFromPayload<CrossClientID>();
-						auto client = connectedClients.find(oldID);
-						if (oldID == 0 || client != connectedClients.end()) {
-							CrossPack pack;
-							pack.SetDataID(StaticDataID::INIT_CLIENT_ID);
-							pack.AddToPayload<CrossClientID>(inClient->clientID);
-							SendToClient(&pack, inClient);
-							if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_INIT)
-								inClient->state = CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE;
-
-							/* execute callbacks */
-							if (failedReconnectEvent && failedReconnectEvent->IsValid())
-								failedReconnectEvent->Execute(inClient);
-							if (connectEvent && connectEvent->IsValid())
-								connectEvent->Execute(inClient);
-							if (initializeClientEvent && initializeClientEvent->IsValid())
-								initializeClientEvent->Execute(inClient);
-						}
-						else { // else we can reconnect..
 
-							// erase the client to update its id
-							connectedClients.erase(inClient->clientID);
+					// finish reconnect and execute callback
+					CrossPack pack;
+					pack.SetDataID(StaticDataID::RECONNECT_PACK);
+					pack.AddToPayload<CrossClientID>(oldID);
+					SendToClient(&pack, inClient);
+					if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_INIT)
+						inClient->state = CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE;
+					if (reconnectEvent && reconnectEvent->IsValid())
+						reconnectEvent->Execute(inClient);
+				}
+			}
+			else if (inPack.GetDataID() == StaticDataID::INIT_CUSTOM_DATA_LIST && inClient) {
+				CrossPackPayloadLen numTotalCustomData = (CrossPackPayloadLen)dataEvents.size();
+				CrossPack outPack;
+				outPack.SetDataID(StaticDataID::INIT_CUSTOM_DATA_LIST);
+				for (CrossPackPayloadLen x = 0; x < numTotalCustomData; x++) {
+					auto dataEvent = dataEvents[x];
+					if (dataEvent) {
+						outPack.ClearPayload();
+						outPack.AddToPayload<CrossPackPayloadLen>(numTotalCustomData);
+						outPack.AddToPayload<CrossPackPayloadLen>(x);
+						outPack.AddStringToPayload(dataEvent->name);
+						outPack.AddToPayload<CrossPackDataID>(dataEvent->dataID);
+						SendToClient(&outPack, inClient);
+					}
+				}
+			}
+			else if (inPack.GetDataID() == StaticDataID::ALIVENESS_TEST && inClient) {
 
-							// update this clients id and add back to the list
-							inClient->clientID = oldID;
-							connectedClients[oldID] = inClient;
+				/* reset timeout timer and update expected timeout delay */
+				float timeoutDelay = inPack.RemoveFromPayload<float>();
+				inClient->ResetTimeout(timeoutDelay);
+			}
+			else if (inPack.GetDataID() == StaticDataID::FRAGMENT_PACK && inClient && (inMethod == NetTransMethod::TCP || inPack.IsValid())) {
+				OnReceiveFragment(inPack, inClient, inMethod);
+			}
+			else { /* custom or unknown data or unknown client */
 
-							// try and find the old client in the disconnect list
-							auto oldClient = disconnectedClients.find(oldID);
-							if (oldClient != disconnectedClients.end() && oldClient->second) {
+				   /* call receive events if data ID / client is known and the packet is valid */
+				if (inClient && inPack.GetDataID() != StaticDataID::UNKNOWN_PACK && (inMethod == NetTransMethod::TCP || inPack.IsValid())) {
 
-								// copy custom data and delete / remove from the disconnected clients list
-								CrossClientEntryPtr oldClientEntry = oldClient->second;
-								inClient->SetCustomData(oldClientEntry->GetCustomData<void>());
-								disconnectedClients.erase(oldClient);
-								oldClientEntry.reset();
-							}
-							else { // otherwise re-initialize this client
-								if (initializeClientEvent && initializeClientEvent->IsValid())
-									initializeClientEvent->Execute(inClient);
-							}
+					/* find the data event if it exists */
+					auto dataEvent = dataEventsByID.find(inPack.GetDataID());
 
-							// finish reconnect and execute callback
-							CrossPack pack;
-							pack.SetDataID(StaticDataID::RECONNECT_PACK);
-							pack.AddToPayload<CrossClientID>(oldID);
-							SendToClient(&pack, inClient);
-							if (inClient->state == CrossClientEntryState::CLIENT_ENTRY_INIT)
-								inClient->state = CrossClientEntryState::CLIENT_ENTRY_DATA_LIST_EXCHANGE;
-							if (reconnectEvent && reconnectEvent->IsValid())
-								reconnectEvent->Execute(inClient);
-						}
+					/* call receive event if it is valid */
+					if (receiveEvent && receiveEvent->IsValid()) {
+						receiveEvent->Execute(&inPack, inClient, inMethod);
+						inPack.Reset();
 					}
-					else if (inPack.GetDataID() == StaticDataID::INIT_CUSTOM_DATA_LIST && inClient) {
-						CrossPackPayloadLen numTotalCustomData = (CrossPackPayloadLen)dataEvents.size();
-						CrossPack outPack;
-						outPack.SetDataID(StaticDataID::INIT_CUSTOM_DATA_LIST);
-						for (CrossPackPayloadLen x = 0; x < numTotalCustomData; x++) {
-							auto dataEvent = dataEvents[x];
-							if (dataEvent) {
-								outPack.ClearPayload();
-								outPack.AddToPayload<CrossPackPayloadLen>(numTotalCustomData);
-								outPack.AddToPayload<CrossPackPayloadLen>(x);
-								outPack.AddStringToPayload(dataEvent->name);
-								outPack.AddToPayload<CrossPackDataID>(dataEvent->dataID);
-								SendToClient(&outPack, inClient);
+
+					/* call custom event callbacks if any exists until finished or the client is disconnected */
+					if (inClient && dataEvent != dataEventsByID.end()) {
+						for (int c = (int)dataEvent->second->GetNumCallbacks() - 1; c >= 0; c--) {
+							if (!IsRunning() || !inClient || !inClient->IsRunning()) {
+								break;
 							}
+							dataEvent->second->Execute(c, &inPack, inClient, inMethod);
+							inPack.Reset();
 						}
 					}
-					else if (inPack.GetDataID() == StaticDataID::ALIVENESS_TEST && inClient) {
 
-						/* reset timeout timer and update expected timeout delay */
-						float timeoutDelay = inPack.RemoveFromPayload<float>();
-						inClient->ResetTimeout(timeoutDelay);
+					/* single packet messages go to the message handlers as well */
+					if (!messageEventsByID.empty()) {
+						auto messageEvent = messageEventsByID.find(inPack.GetDataID());
+						if (messageEvent != messageEventsByID.end()) {
+							CrossMessage message(inPack.GetDataID(), inPack.GetView().GetPayload(), inPack.GetPayloadSize(), inPack.GetReceiveTime());
+							OnReceiveMessage(message, messageEvent->second, inClient, inMethod);
+						}
+					}
+				}
+				else { /* else data ID / client is unknown or checksum is invalid - call transmit error event */
+
+					if (transErrorEvent && transErrorEvent->IsValid()) {
+						NetTransError err;
+						if (!inClient)
+							err = NetTransError::CLIENT_NOT_FOUND;
+						else if (inPack.GetDataID() == StaticDataID::UNKNOWN_PACK)
+							err = NetTransError::INVALID_DATA_ID;
+						else
+							err = NetTransError::INVALID_CHECKSUM;
+						transErrorEvent->Execute(&inPack, inClient, inMethod, err);
 					}
-					else { /* custom or unknown data or unknown client */
+				}
+			}
+		}
 
-						   /* call receive events if data ID / client is known and the packet is valid */
-						if (inClient && inPack.GetDataID() != StaticDataID::UNKNOWN_PACK && (inMethod == NetTransMethod::TCP || inPack.IsValid())) {
+		/* The number of UDP receive slots used with receive offload - each slot holds up to 64 KB */
+		static const int UDP_OFFLOAD_RECEIVE_BATCH = 16;
 
-							/* find the data event if it exists */
-							auto dataEvent = dataEventsByID.find(inPack.GetDataID());
+		/* receive function for a single datagram - datagrams are framed on their own, so a bad datagram can't affect the next */
+		void OnReceiveDatagram(const CrossDatagram& inDatagram)
+		{
+			if (inDatagram.truncated) {
+				if (transErrorEvent && transErrorEvent->IsValid())
+					transErrorEvent->Execute(nullptr, nullptr, NetTransMethod::UDP, NetTransError::INVALID_PAYLOAD_SIZE);
+				return;
+			}
 
-							/* call receive event if it is valid */
-							if (receiveEvent && receiveEvent->IsValid()) {
-								receiveEvent->Execute(&inPack, inClient, inMethod);
-								inPack.Reset();
-							}
+			/* split coalesced datagrams back up - every segment is framed on its own */
+			receiveTime = inDatagram.receiveTime;
+			int segmentSize = inDatagram.segmentSize > 0 ? inDatagram.segmentSize : inDatagram.length;
+			for (int segmentPos = 0; segmentPos < inDatagram.length && IsRunning() && streamIsBound; segmentPos += segmentSize) {
+				CrossBufferLen segmentLength = (inDatagram.length - segmentPos < segmentSize) ? inDatagram.length - segmentPos : segmentSize;
+				CrossBufferLen dataUsed;
+				CrossBufferLen bufferPos = 0;
+				do {
+					dataUsed = OnReceiveNewData(inDatagram.data + segmentPos + bufferPos, segmentLength - bufferPos, nullptr, NetTransMethod::UDP, &inDatagram.address);
+					bufferPos += dataUsed;
+				} while (IsRunning() && streamIsBound && dataUsed > 0 && bufferPos < segmentLength);
+			}
+		}
 
-							/* call custom event callbacks if any exists until finished or the client is disconnected */
-							if (inClient && dataEvent != dataEventsByID.end()) {
-								for (int c = (int)dataEvent->second->GetNumCallbacks() - 1; c >= 0; c--) {
-									if (!IsRunning() || !inClient || !inClient->IsRunning()) {
-										break;
-									}
-									dataEvent->second->Execute(c, &inPack, inClient, inMethod);
-									inPack.Reset();
-								}
-							}
+		/* Allocates the UDP receive slots */
+		void AllocateDatagramSlots(int inCount, int inCapacity)
+		{
+			udpDatagramData = std::vector<CrossPackData>((size_t)inCount * inCapacity);
+			udpDatagrams.resize(inCount);
+			for (size_t d = 0; d < udpDatagrams.size(); d++) {
+				udpDatagrams[d].data = udpDatagramData.data() + d * inCapacity;
+				udpDatagrams[d].capacity = inCapacity;
+			}
+		}
+
+		/* Checks a received packet's raw header against the receive filter - returns false if the packet should be dropped */
+		bool PassesReceiveFilter(const CrossPackHeader& inHeader, const CrossPackData* inData, CrossBufferLen inPacketSize, const CrossClientEntryPtr& inClient, NetTransMethod inMethod, const CrossSockAddress* inFromAddress)
+		{
+			receiveFilterStats.checkedPackets++;
+			int senderState = -1;
+			for (size_t r = 0; r < receiveFilter.size(); r++) {
+				CrossReceiveFilterRule& rule = receiveFilter[r];
+				if ((rule.dataID >= 0 && rule.dataID != inHeader.dataID) || (rule.method >= 0 && rule.method != inMethod)
+					|| inPacketSize < rule.minPacketSize || inPacketSize > rule.maxPacketSize)
+					continue;
+
+				/* the sender is only looked up once a rule needs it */
+				if (rule.sender != CrossFilterSender::FILTER_ANY_SENDER) {
+					if (senderState < 0) {
+						bool isKnown = inClient && inClient->IsRunning();
+						if (inMethod == NetTransMethod::UDP && CrossSysUtil::CheckBit(inHeader.packFlags, CrossPackFlagBit::UDP_SUPPORT_FLAG) && !inClient) {
+							CrossClientID senderID = CrossSysUtil::LoadLittleEndian<CrossClientID>(inData + inPacketSize - sizeof(CrossClientID));
+							CrossClientEntryPtr sender = GetClientEntry(senderID);
+							isKnown = sender && sender->IsRunning();
 						}
-						else { /* else data ID / client is unknown or checksum is invalid - call transmit error event */
-
-							if (transErrorEvent && transErrorEvent->IsValid()) {
-								NetTransError err;
-								if (!inClient)
-									err = NetTransError::CLIENT_NOT_FOUND;
-								else if (inPack.GetDataID() == StaticDataID::UNKNOWN_PACK)
-									err = NetTransError::INVALID_DATA_ID;
-								else
-									err = NetTransError::INVALID_CHECKSUM;
-								transErrorEvent->Execute(&inPack, inClient, inMethod, err);
-							}
+						senderState = isKnown ? CrossFilterSender::FILTER_KNOWN_SENDER : CrossFilterSender::FILTER_UNKNOWN_SENDER;
+					}
+					if (rule.sender != senderState)
+						continue;
+				}
+
+				/* rate limited rules only match once the address is over its rate */
+				if (rule.maxPacketsPerSecond > 0.0) {
+					const CrossSockAddress* source = inFromAddress ? inFromAddress : (inClient ? &inClient->address : nullptr);
+					if (source) {
+						double burst = rule.burstPackets > 1.0 ? rule.burstPackets : 1.0;
+						CrossTokenBucket& bucket = receiveFilterSources[r].GetBucket(*source, rule.maxPacketsPerSecond, burst, tickTime, MAX_FILTER_SOURCES);
+						if (bucket.CanConsume(1.0, tickTime)) {
+							bucket.Consume(1.0);
+							continue;
 						}
 					}
+				}
 
-					/* return packet size */
-					return inPack.GetPacketSize();
+				rule.matchedPackets++;
+				rule.matchedBytes += inPacketSize;
+				if (rule.shouldAccept)
+					return true;
+				receiveFilterStats.droppedPackets++;
+				receiveFilterStats.droppedBytes += inPacketSize;
+				return false;
+			}
+			return true;
+		}
+
+		/* The number of addresses each rate limited filter rule tracks before the least recent ones are replaced */
+		static const size_t MAX_FILTER_SOURCES = 65536;
+
+		/* Creates a non-blocking stream socket with the server's socket options */
+		UDPSocketPtr CreateStreamSocket()
+		{
+			UDPSocketPtr outSocket = CrossSockUtil::CreateUDPSocket(addressFamily);
+			if (outSocket) {
+				outSocket->SetNonBlockingMode(true);
+				outSocket->ApplyProfile(serverProperties.socketProfile);
+				if (serverProperties.numStreamShards > 1)
+					outSocket->SetReusePortMode(true);
+				if (serverProperties.useReceiveTimestamps)
+					outSocket->SetReceiveTimestampMode(true);
+
+				/* coalesced receives need fewer, larger slots */
+				if (serverProperties.allowUDPReceiveOffload && outSocket->SetReceiveOffloadMode(true) == CrossSockError::SUCCESS)
+					AllocateDatagramSlots(UDP_OFFLOAD_RECEIVE_BATCH, UDPSocket::MAX_COALESCED_BYTES + 1);
+			}
+			return outSocket;
+		}
+
+		/* Binds the remaining stream shards next to the bound stream socket and steers each client's datagrams by its ID */
+		void BindStreamShards(const CrossSockAddress& inAddress)
+		{
+			streamShards.clear();
+			streamShards.push_back(streamSocket);
+			for (int s = 1; s < serverProperties.numStreamShards; s++) {
+				UDPSocketPtr shard = CreateStreamSocket();
+				if (!shard || shard->Bind(inAddress) < 0) {
+					if (shard)
+						shard->Close();
+					break;
 				}
+				streamShards.push_back(shard);
 			}
 
-			/* return 0 - no buffer data used */
-			return 0;
+			/* the steering program reads the low bits of the sender ID at the end of the footer */
+			if (streamShards.size() > 1) {
+				if (streamSocket->SetReusePortSteering(sizeof(CrossPackDataID) + sizeof(CrossPackPayloadLen), CrossPackFlagBit::UDP_SUPPORT_FLAG,
+					sizeof(CrossClientID), (unsigned int)streamShards.size()) != CrossSockError::SUCCESS) {
+					for (size_t s = 1; s < streamShards.size(); s++) {
+						streamShards[s]->Close();
+					}
+					streamShards.resize(1);
+				}
+			}
+		}
+
+		/* Receives batches of datagrams from a stream socket until it is empty or the update's UDP transmits are used up */
+		void ReceiveDatagrams(UDPSocketPtr inSocket, int& inOutTransmits)
+		{
+			int batchSize;
+			int datagramsReceived;
+			do {
+				/* receive a batch of datagrams - each is parsed on its own */
+				batchSize = serverProperties.maxUDPTransmitsPerUpdate - inOutTransmits;
+				if (batchSize > (int)udpDatagrams.size())
+					batchSize = (int)udpDatagrams.size();
+				datagramsReceived = inSocket->ReceiveMany(udpDatagrams.data(), batchSize);
+				if (datagramsReceived > 0) {
+					inOutTransmits += datagramsReceived;
+					for (int d = 0; d < datagramsReceived && IsRunning() && streamIsBound; d++) {
+						OnReceiveDatagram(udpDatagrams[d]);
+					}
+				}
+				else if (CrossSockUtil::GetLastError() == CrossSockError::CONNRESET) {
+					CloseStreamSockets();
+				}
+			} while (IsRunning() && streamIsBound && datagramsReceived == batchSize && inOutTransmits < serverProperties.maxUDPTransmitsPerUpdate);
+		}
+
+		/* Closes every stream socket - they are bound again on the next update */
+		void CloseStreamSockets()
+		{
+			for (size_t s = 1; s < streamShards.size(); s++) {
+				streamShards[s]->Close();
+			}
+			streamShards.clear();
+			if (streamSocket) {
+				streamSocket->Close();
+				streamSocket.reset();
+			}
+			streamIsBound = false;
+		}
+
+		/* Unpacks each packet of an aggregate packet - the packets are sent without their sender ID and share the aggregate's */
+		void OnReceiveAggregate(const CrossPack& inAggregate, CrossPackData* inData, CrossClientEntryPtr inClient, NetTransMethod inMethod)
+		{
+			CrossBufferLen aggregateEnd = CrossPack::GetHeaderSize() + inAggregate.GetPayloadSize();
+			CrossBufferLen bufferPos = CrossPack::GetHeaderSize();
+			while (bufferPos + CrossPack::GetHeaderSize() <= aggregateEnd && IsRunning() && (!inClient || inClient->IsRunning())) {
+				CrossPackHeader header = CrossPack::PeakHeader(inData + bufferPos);
+				CrossBufferLen packetSize = CrossPack::GetHeaderSize() + header.payloadSize + CrossPack::GetFooterLength(header);
+				if (header.dataID == StaticDataID::AGGREGATE_PACK || bufferPos + packetSize > aggregateEnd) {
+					if (transErrorEvent && transErrorEvent->IsValid())
+						transErrorEvent->Execute(nullptr, inClient, inMethod, NetTransError::INVALID_PAYLOAD_SIZE);
+					return;
+				}
+				if (!receiveFilter.empty() && !PassesReceiveFilter(header, inData + bufferPos, packetSize, inClient, inMethod, inClient ? &inClient->streamAddress : nullptr)) {
+					bufferPos += packetSize;
+					continue;
+				}
+				CrossPackFooter footer = CrossPack::PeakFooter(inData + bufferPos, header);
+				footer.senderID = inAggregate.GetSenderID();
+				header.packFlags = CrossSysUtil::SetBit(header.packFlags, CrossPackFlagBit::UDP_SUPPORT_FLAG);
+				CrossPack inPack(header, footer, inData + bufferPos);
+				inPack.SetReceiveTime(receiveTime);
+				OnReceivePack(inPack, inClient, inMethod);
+				bufferPos += packetSize;
+			}
 		}
 
 		/* Fills the data event hash tables for ~O(k) access */
@@ -1531,6 +3261,10 @@ namespace CrossSock {
 				dataEventsByID[dataEvents[d]->dataID] = dataEvents[d];
 				dataEventsByName[dataEvents[d]->name] = dataEvents[d];
 			}
+			messageEventsByID.clear();
+			for (size_t m = 0; m < messageEvents.size(); m++) {
+				messageEventsByID[messageEvents[m]->dataID] = messageEvents[m];
+			}
 		}
 	};
 
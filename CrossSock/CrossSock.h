@@ -32,6 +32,7 @@
 /* Includes and defines */
 #include <memory>
 #include <vector>
+#include <deque>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -49,11 +50,19 @@
 #else
 	#include <sys/socket.h>
 	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <netinet/udp.h>
 	#include <sys/types.h>
 	#include <netdb.h>
 	#include <errno.h>
 	#include <fcntl.h>
 	#include <unistd.h>
+	#include <sys/ioctl.h>
+	#ifdef __linux__
+		#include <linux/errqueue.h>
+		#include <linux/filter.h>
+		#include <linux/net_tstamp.h>
+	#endif
 	typedef int SOCKET;
 	const int NO_ERROR = 0;
 	const int INVALID_SOCKET = -1;
@@ -67,6 +76,41 @@
 
 #include "CrossUtil.h"
 
+/* Zero-copy sends are only available on linux kernels that support SO_ZEROCOPY */
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+	#define CROSS_SOCK_ZEROCOPY 1
+#else
+	#define CROSS_SOCK_ZEROCOPY 0
+#endif
+
+/* UDP generic segmentation offload is only available on linux kernels that support UDP_SEGMENT */
+#if defined(__linux__) && defined(UDP_SEGMENT)
+	#define CROSS_SOCK_UDP_GSO 1
+#else
+	#define CROSS_SOCK_UDP_GSO 0
+#endif
+
+/* UDP generic receive offload is only available on linux kernels that support UDP_GRO */
+#if defined(__linux__) && defined(UDP_GRO)
+	#define CROSS_SOCK_UDP_GRO 1
+#else
+	#define CROSS_SOCK_UDP_GRO 0
+#endif
+
+/* Steering datagrams between sockets that share a port is only available on linux kernels that support SO_ATTACH_REUSEPORT_CBPF */
+#if defined(__linux__) && defined(SO_REUSEPORT) && defined(SO_ATTACH_REUSEPORT_CBPF)
+	#define CROSS_SOCK_REUSEPORT_STEERING 1
+#else
+	#define CROSS_SOCK_REUSEPORT_STEERING 0
+#endif
+
+/* Kernel receive timestamps are only available on linux kernels that support SO_TIMESTAMPING */
+#if defined(__linux__) && defined(SO_TIMESTAMPING) && defined(SCM_TIMESTAMPING)
+	#define CROSS_SOCK_TIMESTAMPING 1
+#else
+	#define CROSS_SOCK_TIMESTAMPING 0
+#endif
+
 /* Socket Addressing */
 	namespace CrossSock {
 		enum CrossSockAddressFamily
@@ -238,8 +282,217 @@
 		};
 	}
 
+/*
+ * Socket tuning profiles - a declarative set of socket options that can be
+ * applied to any socket. Options left at -1 keep the system default. Some
+ * options are only available on some systems (TCP_QUICKACK and SO_PRIORITY
+ * are linux only), and are silently skipped elsewhere.
+ */
+	namespace CrossSock {
+		struct CrossSockProfile
+		{
+			/* TCP only: 1 disables Nagle's algorithm (TCP_NODELAY), 0 enables it */
+			int noDelay;
+
+			/* TCP only: 1 acknowledges data immediately (TCP_QUICKACK) - note that the kernel may fall back to delayed acks */
+			int quickAck;
+
+			/* The size of the kernel send buffer in bytes (SO_SNDBUF) */
+			int sendBufferSize;
+
+			/* The size of the kernel receive buffer in bytes (SO_RCVBUF) */
+			int receiveBufferSize;
+
+			/* The IP type of service byte (IP_TOS) - the DSCP code point is the upper 6 bits */
+			int typeOfService;
+
+			/* The priority of this socket's packets in the local queues (SO_PRIORITY) */
+			int priority;
+
+			CrossSockProfile()
+			{
+				noDelay = -1;
+				quickAck = -1;
+				sendBufferSize = -1;
+				receiveBufferSize = -1;
+				typeOfService = -1;
+				priority = -1;
+			}
+
+			/* Keep every system default */
+			static CrossSockProfile Default()
+			{
+				return CrossSockProfile();
+			}
+
+			/* Small, frequent messages - no Nagle delay, immediate acks and expedited forwarding (DSCP 46) */
+			static CrossSockProfile LowLatency()
+			{
+				CrossSockProfile profile;
+				profile.noDelay = 1;
+				profile.quickAck = 1;
+				profile.typeOfService = 46 << 2;
+				profile.priority = 6;
+				return profile;
+			}
+
+			/* Large transfers - Nagle coalescing, large kernel buffers and high throughput forwarding (DSCP 10) */
+			static CrossSockProfile BulkThroughput()
+			{
+				CrossSockProfile profile;
+				profile.noDelay = 0;
+				profile.sendBufferSize = 4 * 1024 * 1024;
+				profile.receiveBufferSize = 4 * 1024 * 1024;
+				profile.typeOfService = 10 << 2;
+				profile.priority = 0;
+				return profile;
+			}
+		};
+	}
+
 /* UDP Sockets */
 	namespace CrossSock {
+
+		/*
+		 * A slot for a single received datagram - the caller provides the data buffer and its
+		 * capacity, the receive fills in the rest. Datagrams larger than the capacity are cut
+		 * short and flagged as truncated. With receive offload, a slot can hold several datagrams
+		 * from the same sender back to back - each segmentSize bytes long except the last.
+		 */
+		struct CrossDatagram
+		{
+			char* data;
+			int capacity;
+			int length;
+			int segmentSize;
+			CrossSockAddress address;
+			bool truncated;
+			int64_t receiveTime;
+		};
+
+#if CROSS_SOCK_TIMESTAMPING
+		/* Kernel timestamp helpers shared by both socket types */
+		class CrossSockTimestamp
+		{
+		public:
+
+			/* The SO_TIMESTAMPING flags requested - software timestamps, taken from the system clock when the kernel receives the data */
+			static int GetReceiveFlags()
+			{
+				return SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+			}
+
+			/*
+			 * Returns the software receive time (in ns since the epoch) held by a message's control data, or 0 if it has
+			 * none. Hardware timestamps come from the NIC's own clock, so they can't be compared with the system clock
+			 */
+			static int64_t FromControl(msghdr* inMessage)
+			{
+				for (cmsghdr* control = CMSG_FIRSTHDR(inMessage); control; control = CMSG_NXTHDR(inMessage, control)) {
+					if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMPING) {
+						timespec times[3];
+						memcpy(times, CMSG_DATA(control), sizeof(times));
+						return (int64_t)times[0].tv_sec * 1000000000 + times[0].tv_nsec;
+					}
+				}
+				return 0;
+			}
+
+			/* The control buffer space needed for a timestamp */
+			static const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(timespec) * 3);
+		};
+#endif
+
+		/* Socket option helpers shared by both socket types */
+		class CrossSockOptions
+		{
+		public:
+
+			/* Set a raw socket option - returns SUCCESS if succesful */
+			template <class T>
+			static int Set(SOCKET inSocket, int inLevel, int inName, const T& inValue)
+			{
+				return setsockopt(inSocket, inLevel, inName, reinterpret_cast<const char*>(&inValue), sizeof(T));
+			}
+
+			/* Get a raw socket option - returns SUCCESS if succesful */
+			template <class T>
+			static int Get(SOCKET inSocket, int inLevel, int inName, T& outValue)
+			{
+				socklen_t length = sizeof(T);
+				return getsockopt(inSocket, inLevel, inName, reinterpret_cast<char*>(&outValue), &length);
+			}
+
+			/* Set the size of a socket's kernel send buffer in bytes */
+			static int SetSendBufferSize(SOCKET inSocket, int inBytes)
+			{
+				return Set<int>(inSocket, SOL_SOCKET, SO_SNDBUF, inBytes);
+			}
+
+			/* Set the size of a socket's kernel receive buffer in bytes */
+			static int SetReceiveBufferSize(SOCKET inSocket, int inBytes)
+			{
+				return Set<int>(inSocket, SOL_SOCKET, SO_RCVBUF, inBytes);
+			}
+
+			/* Set a socket's IP type of service byte (the IPv6 traffic class on IPv6 sockets) */
+			static int SetTypeOfService(SOCKET inSocket, int inTypeOfService)
+			{
+#ifdef IPV6_TCLASS
+				if (GetFamily(inSocket) == AF_INET6)
+					return Set<int>(inSocket, IPPROTO_IPV6, IPV6_TCLASS, inTypeOfService);
+#endif
+				return Set<int>(inSocket, IPPROTO_IP, IP_TOS, inTypeOfService);
+			}
+
+			/* Returns the address family of a socket (AF_INET or AF_INET6), or AF_UNSPEC if it can't be found */
+			static int GetFamily(SOCKET inSocket)
+			{
+				sockaddr_storage addr;
+				socklen_t length = sizeof(addr);
+				if (getsockname(inSocket, reinterpret_cast<sockaddr*>(&addr), &length) != 0)
+					return AF_UNSPEC;
+				return addr.ss_family;
+			}
+
+			/* Set the priority of a socket's packets in the local queues - linux only */
+			static int SetPriority(SOCKET inSocket, int inPriority)
+			{
+#ifdef SO_PRIORITY
+				return Set<int>(inSocket, SOL_SOCKET, SO_PRIORITY, inPriority);
+#else
+				return SOCKET_ERROR;
+#endif
+			}
+
+			/* Turns kernel receive timestamps (SO_TIMESTAMPING, linux only) on or off - returns SUCCESS if they are now in the requested mode */
+			static int SetReceiveTimestampMode(SOCKET inSocket, bool inShouldTimestamp)
+			{
+#if CROSS_SOCK_TIMESTAMPING
+				return Set<int>(inSocket, SOL_SOCKET, SO_TIMESTAMPING, inShouldTimestamp ? CrossSockTimestamp::GetReceiveFlags() : 0);
+#else
+				return inShouldTimestamp ? SOCKET_ERROR : NO_ERROR;
+#endif
+			}
+
+			/* Apply each set option of a socket profile that isn't TCP only - returns SUCCESS if every supported option was applied */
+			static int ApplyProfile(SOCKET inSocket, const CrossSockProfile& inProfile)
+			{
+				int result = CrossSockError::SUCCESS;
+				if (inProfile.sendBufferSize >= 0 && SetSendBufferSize(inSocket, inProfile.sendBufferSize) != 0)
+					result = CrossSockError::INVALID;
+				if (inProfile.receiveBufferSize >= 0 && SetReceiveBufferSize(inSocket, inProfile.receiveBufferSize) != 0)
+					result = CrossSockError::INVALID;
+				if (inProfile.typeOfService >= 0 && SetTypeOfService(inSocket, inProfile.typeOfService) != 0)
+					result = CrossSockError::INVALID;
+#ifdef SO_PRIORITY
+				if (inProfile.priority >= 0 && SetPriority(inSocket, inProfile.priority) != 0)
+					result = CrossSockError::INVALID;
+#endif
+				return result;
+			}
+		};
+
 		class UDPSocket
 		{
 		public:
@@ -264,6 +517,218 @@
 					0, &inToAddress.mSockAddr, inToAddress.GetSize());
 			}
 
+			/*
+			 * Send the same data to many addresses - returns the number of datagrams sent, or a
+			 * negative value if none could be sent. Linux batches the datagrams into sendmmsg
+			 * calls, other systems send them one at a time.
+			 */
+			int SendToMany(const char* inToSend, int inLength, const CrossSockAddress* inToAddresses, int inCount)
+			{
+				int sent = 0;
+#ifdef __linux__
+				iovec data;
+				data.iov_base = const_cast<char*>(inToSend);
+				data.iov_len = inLength;
+				mmsghdr messages[MAX_SEND_BATCH];
+				while (sent < inCount) {
+					int batchSize = (inCount - sent < MAX_SEND_BATCH) ? inCount - sent : MAX_SEND_BATCH;
+					for (int m = 0; m < batchSize; m++) {
+						memset(&messages[m], 0, sizeof(mmsghdr));
+						messages[m].msg_hdr.msg_name = const_cast<sockaddr*>(&inToAddresses[sent + m].mSockAddr);
+						messages[m].msg_hdr.msg_namelen = inToAddresses[sent + m].GetSize();
+						messages[m].msg_hdr.msg_iov = &data;
+						messages[m].msg_hdr.msg_iovlen = 1;
+					}
+					int result = sendmmsg(mSocket, messages, batchSize, 0);
+					if (result <= 0)
+						return (sent > 0) ? sent : result;
+					sent += result;
+				}
+#else
+				while (sent < inCount) {
+					if (SendTo(inToSend, inLength, inToAddresses[sent]) < 0)
+						return (sent > 0) ? sent : SOCKET_ERROR;
+					sent++;
+				}
+#endif
+				return sent;
+			}
+
+			/*
+			 * Send a contiguous buffer of datagrams to an address - every datagram is inSegmentSize bytes
+			 * except the last, which may be shorter. The kernel splits the buffer itself (UDP_SEGMENT),
+			 * so that up to 64 datagrams go out in a single call. Falls back to one send per datagram if
+			 * the kernel doesn't support segmentation offload, or if a datagram and its IP and UDP headers
+			 * don't fit in the path MTU (see SetPathMTU). Returns the number of bytes sent, which ends
+			 * on a datagram boundary short of inLength if the socket ran out of room part way through.
+			 */
+			int SendSegmentsTo(const char* inToSend, int inLength, int inSegmentSize, const CrossSockAddress& inToAddress)
+			{
+				int sent = 0;
+#if CROSS_SOCK_UDP_GSO
+				int maxSegmentSize = mPathMTU - ((inToAddress.GetFamily() == AF_INET6) ? IPV6_UDP_HEADER_BYTES : IPV4_UDP_HEADER_BYTES);
+				while (mSegmentOffload && inSegmentSize <= maxSegmentSize && inLength - sent > inSegmentSize) {
+					int numSegments = (inLength - sent + inSegmentSize - 1) / inSegmentSize;
+					if (numSegments > MAX_SEND_BATCH)
+						numSegments = MAX_SEND_BATCH;
+					if (numSegments * inSegmentSize > MAX_SEGMENTED_BYTES)
+						numSegments = MAX_SEGMENTED_BYTES / inSegmentSize;
+					int length = numSegments * inSegmentSize;
+					if (length > inLength - sent)
+						length = inLength - sent;
+
+					iovec data;
+					data.iov_base = const_cast<char*>(inToSend + sent);
+					data.iov_len = length;
+					char control[CMSG_SPACE(sizeof(uint16_t))];
+					memset(control, 0, sizeof(control));
+					msghdr msg;
+					memset(&msg, 0, sizeof(msg));
+					msg.msg_name = const_cast<sockaddr*>(&inToAddress.mSockAddr);
+					msg.msg_namelen = inToAddress.GetSize();
+					msg.msg_iov = &data;
+					msg.msg_iovlen = 1;
+					msg.msg_control = control;
+					msg.msg_controllen = sizeof(control);
+					cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+					cmsg->cmsg_level = SOL_UDP;
+					cmsg->cmsg_type = UDP_SEGMENT;
+					cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+					uint16_t segmentSize = (uint16_t)inSegmentSize;
+					memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(uint16_t));
+
+					int result = sendmsg(mSocket, &msg, 0);
+					if (result < 0) {
+						if (errno == EIO || errno == ENOPROTOOPT || errno == EOPNOTSUPP) {
+							/* no offload support on this kernel or device - send each datagram instead */
+							mSegmentOffload = false;
+							break;
+						}
+						if (errno == EINVAL || errno == EMSGSIZE) {
+							/* the segments don't fit the route's MTU - send each datagram of this call instead */
+							break;
+						}
+						return (sent > 0) ? sent : result;
+					}
+					sent += result;
+				}
+#endif
+				while (sent < inLength) {
+					int length = (inLength - sent < inSegmentSize) ? inLength - sent : inSegmentSize;
+					int result = SendTo(inToSend + sent, length, inToAddress);
+					if (result < 0)
+						return (sent > 0) ? sent : result;
+					sent += result;
+				}
+				return sent;
+			}
+
+			/* Sets the path MTU segmented sends are checked against - datagrams that don't fit are sent one at a time */
+			void SetPathMTU(int inPathMTU)
+			{
+				mPathMTU = inPathMTU;
+			}
+
+			/* Returns the path MTU segmented sends are checked against */
+			int GetPathMTU() const
+			{
+				return mPathMTU;
+			}
+
+			/* Returns true if segmented sends are offloaded to the kernel - false if they fall back to one send per datagram */
+			bool IsSegmentOffloadSupported() const
+			{
+				return mSegmentOffload;
+			}
+
+			/*
+			 * Lets the kernel coalesce datagrams from the same sender into a single receive (UDP_GRO) - a
+			 * coalesced receive can be up to 64 KB, so slots given to ReceiveMany need to be at least that
+			 * large. Returns SUCCESS if receive offload is now in the requested mode.
+			 */
+			int SetReceiveOffloadMode(bool inShouldCoalesce)
+			{
+#if CROSS_SOCK_UDP_GRO
+				int result = SetOption<int>(SOL_UDP, UDP_GRO, inShouldCoalesce ? 1 : 0);
+				if (result == 0)
+					mReceiveOffload = inShouldCoalesce;
+				return result;
+#else
+				return inShouldCoalesce ? SOCKET_ERROR : NO_ERROR;
+#endif
+			}
+
+			/* Returns true if receives may hold several coalesced datagrams - false otherwise */
+			bool IsReceiveOffloadEnabled() const
+			{
+				return mReceiveOffload;
+			}
+
+			/*
+			 * Records the kernel receive time (SO_TIMESTAMPING, linux only) of every datagram taken by
+			 * ReceiveMany - returns SUCCESS if timestamps are now in the requested mode
+			 */
+			int SetReceiveTimestampMode(bool inShouldTimestamp)
+			{
+				int result = CrossSockOptions::SetReceiveTimestampMode(mSocket, inShouldTimestamp);
+				if (result == 0)
+					mReceiveTimestamps = inShouldTimestamp;
+				return result;
+			}
+
+			/* Returns true if received datagrams carry their kernel receive time - false otherwise */
+			bool IsReceiveTimestampEnabled() const
+			{
+				return mReceiveTimestamps;
+			}
+
+			/* Lets other sockets bind to this socket's port (SO_REUSEPORT) - must be set before binding. Returns SUCCESS if succesful */
+			int SetReusePortMode(bool inShouldReuse)
+			{
+#ifdef SO_REUSEPORT
+				return SetOption<int>(SOL_SOCKET, SO_REUSEPORT, inShouldReuse ? 1 : 0);
+#else
+				return inShouldReuse ? SOCKET_ERROR : NO_ERROR;
+#endif
+			}
+
+			/*
+			 * Steers each datagram arriving on this socket's port to one of the inNumSockets sockets bound to it
+			 * (in bind order) with a classic BPF program run by the kernel. The key is the 16 bit little endian
+			 * value inKeyOffsetFromEnd bytes before the end of the datagram, and the socket is key % inNumSockets.
+			 * Datagrams without the given bit set in the byte at inFlagOffset fall back to the kernel's hash.
+			 * Returns SUCCESS if succesful - linux only.
+			 */
+			int SetReusePortSteering(int inFlagOffset, int inFlagBit, int inKeyOffsetFromEnd, unsigned int inNumSockets)
+			{
+#if CROSS_SOCK_REUSEPORT_STEERING
+				if (inNumSockets == 0)
+					return SOCKET_ERROR;
+				sock_filter code[] = {
+					BPF_STMT(BPF_LD | BPF_B | BPF_ABS, (unsigned int)inFlagOffset),
+					BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 1u << inFlagBit, 0, 11),
+					BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0),
+					BPF_STMT(BPF_ALU | BPF_SUB | BPF_K, (unsigned int)inKeyOffsetFromEnd),
+					BPF_STMT(BPF_MISC | BPF_TAX, 0),
+					BPF_STMT(BPF_LD | BPF_B | BPF_IND, 1),
+					BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 8),
+					BPF_STMT(BPF_ST, 0),
+					BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),
+					BPF_STMT(BPF_LDX | BPF_W | BPF_MEM, 0),
+					BPF_STMT(BPF_ALU | BPF_OR | BPF_X, 0),
+					BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, inNumSockets),
+					BPF_STMT(BPF_RET | BPF_A, 0),
+					BPF_STMT(BPF_RET | BPF_K, inNumSockets)
+				};
+				sock_fprog program;
+				program.len = sizeof(code) / sizeof(code[0]);
+				program.filter = code;
+				return SetOption<sock_fprog>(SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, program);
+#else
+				return SOCKET_ERROR;
+#endif
+			}
+
 			/* Receive data - returns the number of bytes received and the peer address*/
 			int ReceiveFrom(char* inToReceive, int inMaxLength, CrossSockAddress& outFromAddress)
 			{
@@ -275,6 +740,82 @@
 					0, &outFromAddress.mSockAddr, &fromLength);
 			}
 
+			/*
+			 * Receive up to inCount datagrams, one per slot - returns the number of slots filled, or
+			 * SOCKET_ERROR if nothing was received. Linux receives the whole batch in a single call
+			 * (recvmmsg), other systems receive one datagram at a time. A datagram that fills its slot
+			 * completely is also flagged as truncated, so give slots one byte more than the largest
+			 * expected datagram.
+			 */
+			int ReceiveMany(CrossDatagram* outDatagrams, int inCount)
+			{
+				int received = 0;
+#ifdef __linux__
+				iovec data[MAX_RECEIVE_BATCH];
+				mmsghdr messages[MAX_RECEIVE_BATCH];
+#if CROSS_SOCK_UDP_GRO || CROSS_SOCK_TIMESTAMPING
+				char control[MAX_RECEIVE_BATCH][CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(timespec) * 3)];
+				bool hasControl = mReceiveOffload || mReceiveTimestamps;
+#endif
+				while (received < inCount) {
+					int batchSize = (inCount - received < MAX_RECEIVE_BATCH) ? inCount - received : MAX_RECEIVE_BATCH;
+					for (int m = 0; m < batchSize; m++) {
+						CrossDatagram& datagram = outDatagrams[received + m];
+						data[m].iov_base = datagram.data;
+						data[m].iov_len = datagram.capacity;
+						memset(&messages[m], 0, sizeof(mmsghdr));
+						messages[m].msg_hdr.msg_name = &datagram.address.mSockAddr;
+						messages[m].msg_hdr.msg_namelen = datagram.address.GetSize();
+						messages[m].msg_hdr.msg_iov = &data[m];
+						messages[m].msg_hdr.msg_iovlen = 1;
+#if CROSS_SOCK_UDP_GRO || CROSS_SOCK_TIMESTAMPING
+						if (hasControl) {
+							messages[m].msg_hdr.msg_control = control[m];
+							messages[m].msg_hdr.msg_controllen = sizeof(control[m]);
+						}
+#endif
+					}
+					int result = recvmmsg(mSocket, messages, batchSize, MSG_WAITFORONE, nullptr);
+					if (result <= 0)
+						return (received > 0) ? received : SOCKET_ERROR;
+					for (int m = 0; m < result; m++) {
+						CrossDatagram& datagram = outDatagrams[received + m];
+						datagram.length = messages[m].msg_len;
+						datagram.segmentSize = 0;
+						datagram.receiveTime = 0;
+						datagram.truncated = (messages[m].msg_hdr.msg_flags & MSG_TRUNC) != 0 || datagram.length >= datagram.capacity;
+#if CROSS_SOCK_UDP_GRO
+						/* coalesced datagrams carry their segment size */
+						for (cmsghdr* message = CMSG_FIRSTHDR(&messages[m].msg_hdr); message; message = CMSG_NXTHDR(&messages[m].msg_hdr, message)) {
+							if (message->cmsg_level == SOL_UDP && message->cmsg_type == UDP_GRO)
+								memcpy(&datagram.segmentSize, CMSG_DATA(message), sizeof(int));
+						}
+#endif
+#if CROSS_SOCK_TIMESTAMPING
+						if (mReceiveTimestamps)
+							datagram.receiveTime = CrossSockTimestamp::FromControl(&messages[m].msg_hdr);
+#endif
+					}
+					received += result;
+					if (result < batchSize)
+						break;
+				}
+#else
+				while (received < inCount) {
+					CrossDatagram& datagram = outDatagrams[received];
+					int result = ReceiveFrom(datagram.data, datagram.capacity, datagram.address);
+					if (result < 0)
+						return (received > 0) ? received : SOCKET_ERROR;
+					datagram.length = result;
+					datagram.segmentSize = 0;
+					datagram.receiveTime = 0;
+					datagram.truncated = datagram.length >= datagram.capacity;
+					received++;
+				}
+#endif
+				return received;
+			}
+
 			/* Sets this socket to blocking or non-blocking */
 			int SetNonBlockingMode(bool inShouldBeNonBlocking)
 			{
@@ -289,6 +830,56 @@
 				return result;
 			}
 
+			/* Set a raw socket option - returns SUCCESS if succesful */
+			template <class T>
+			int SetOption(int inLevel, int inName, const T& inValue)
+			{
+				return CrossSockOptions::Set<T>(mSocket, inLevel, inName, inValue);
+			}
+
+			/* Get a raw socket option - returns SUCCESS if succesful */
+			template <class T>
+			int GetOption(int inLevel, int inName, T& outValue) const
+			{
+				return CrossSockOptions::Get<T>(mSocket, inLevel, inName, outValue);
+			}
+
+			/* Set the size of the kernel send buffer in bytes */
+			int SetSendBufferSize(int inBytes)
+			{
+				return CrossSockOptions::SetSendBufferSize(mSocket, inBytes);
+			}
+
+			/* Set the size of the kernel receive buffer in bytes */
+			int SetReceiveBufferSize(int inBytes)
+			{
+				return CrossSockOptions::SetReceiveBufferSize(mSocket, inBytes);
+			}
+
+			/* Set the IP type of service byte (the IPv6 traffic class on IPv6 sockets) - the DSCP code point is the upper 6 bits */
+			int SetTypeOfService(int inTypeOfService)
+			{
+				return CrossSockOptions::SetTypeOfService(mSocket, inTypeOfService);
+			}
+
+			/* Returns the address family of this socket (AF_INET or AF_INET6), or AF_UNSPEC if it can't be found */
+			int GetFamily() const
+			{
+				return CrossSockOptions::GetFamily(mSocket);
+			}
+
+			/* Set the priority of this socket's packets in the local queues - linux only */
+			int SetPriority(int inPriority)
+			{
+				return CrossSockOptions::SetPriority(mSocket, inPriority);
+			}
+
+			/* Apply each set option of a socket profile (TCP only options are ignored) - returns SUCCESS if every supported option was applied */
+			int ApplyProfile(const CrossSockProfile& inProfile)
+			{
+				return CrossSockOptions::ApplyProfile(mSocket, inProfile);
+			}
+
 			/*Gets the local address associated with this socket */
 			CrossSockAddress GetLocalAddress() const
 			{
@@ -317,10 +908,33 @@
 #endif
 			}
 
+			/* The maximum number of datagrams handed to the kernel in a single batched send */
+			static const int MAX_SEND_BATCH = 64;
+
+			/* The maximum number of datagrams taken from the kernel in a single batched receive */
+			static const int MAX_RECEIVE_BATCH = 64;
+
+			/* The largest receive the kernel coalesces datagrams into */
+			static const int MAX_COALESCED_BYTES = 65535;
+
+			/* The maximum number of bytes handed to the kernel in a single segmented send */
+			static const int MAX_SEGMENTED_BYTES = 65000;
+
+			/* The path MTU assumed until SetPathMTU is called - that of ethernet */
+			static const int DEFAULT_PATH_MTU = 1500;
+
+			/* The IP and UDP header bytes that go with each datagram */
+			static const int IPV4_UDP_HEADER_BYTES = 20 + 8;
+			static const int IPV6_UDP_HEADER_BYTES = 40 + 8;
+
 		private:
 			friend class CrossSockUtil;
-			UDPSocket(SOCKET inSocket) : mSocket(inSocket) {}
+			UDPSocket(SOCKET inSocket) : mSocket(inSocket), mPathMTU(DEFAULT_PATH_MTU), mSegmentOffload(CROSS_SOCK_UDP_GSO != 0), mReceiveOffload(false), mReceiveTimestamps(false) {}
 			SOCKET mSocket;
+			int mPathMTU;
+			bool mSegmentOffload;
+			bool mReceiveOffload;
+			bool mReceiveTimestamps;
 
 		};
 
@@ -385,6 +999,147 @@
 				return recv(mSocket, inBuffer, inLen, 0);
 			}
 
+			/*
+			 * Receive data from the peer along with its kernel receive time (in ns since the epoch) - the time is that
+			 * of the newest segment read, or 0 if receive timestamps are disabled. Returns the number of bytes received
+			 */
+			int Receive(char* inBuffer, int inLen, int64_t& outReceiveTime)
+			{
+				outReceiveTime = 0;
+#if CROSS_SOCK_TIMESTAMPING
+				if (mReceiveTimestamps) {
+					char control[CrossSockTimestamp::CONTROL_SIZE];
+					iovec data;
+					data.iov_base = inBuffer;
+					data.iov_len = inLen;
+					msghdr message;
+					memset(&message, 0, sizeof(message));
+					message.msg_iov = &data;
+					message.msg_iovlen = 1;
+					message.msg_control = control;
+					message.msg_controllen = sizeof(control);
+					int result = recvmsg(mSocket, &message, 0);
+					if (result > 0)
+						outReceiveTime = CrossSockTimestamp::FromControl(&message);
+					return result;
+				}
+#endif
+				return recv(mSocket, inBuffer, inLen, 0);
+			}
+
+			/* Records the kernel receive time (SO_TIMESTAMPING, linux only) of received data - returns SUCCESS if timestamps are now in the requested mode */
+			int SetReceiveTimestampMode(bool inShouldTimestamp)
+			{
+				int result = CrossSockOptions::SetReceiveTimestampMode(mSocket, inShouldTimestamp);
+				if (result == 0)
+					mReceiveTimestamps = inShouldTimestamp;
+				return result;
+			}
+
+			/* Returns true if received data carries its kernel receive time - false otherwise */
+			bool IsReceiveTimestampEnabled() const
+			{
+				return mReceiveTimestamps;
+			}
+
+			/* Enables or disables zero-copy sends (SO_ZEROCOPY) - returns false if zero-copy is unsupported on this system */
+			bool SetZeroCopyMode(bool inShouldZeroCopy)
+			{
+#if CROSS_SOCK_ZEROCOPY
+				int value = inShouldZeroCopy ? 1 : 0;
+				if (setsockopt(mSocket, SOL_SOCKET, SO_ZEROCOPY, &value, sizeof(value)) == 0) {
+					mZeroCopyEnabled = inShouldZeroCopy;
+					return true;
+				}
+#endif
+				mZeroCopyEnabled = false;
+				return !inShouldZeroCopy;
+			}
+
+			/* Returns true if zero-copy sends are enabled on this socket - false otherwise */
+			bool IsZeroCopyEnabled() const
+			{
+				return mZeroCopyEnabled;
+			}
+
+			/*
+			 * Send data to the peer without copying it into the kernel - returns the number of bytes sent.
+			 * The owner is kept alive until the kernel reports that it is done with the data (see
+			 * PollZeroCopyCompletions), so the same buffer can be shared across many sockets. Falls back
+			 * to a regular send if zero-copy is disabled or the kernel is out of zero-copy resources.
+			 */
+			int SendZeroCopy(const char* inData, int inLen, const std::shared_ptr<const void>& inOwner)
+			{
+#if CROSS_SOCK_ZEROCOPY
+				if (mZeroCopyEnabled) {
+					int result = send(mSocket, inData, inLen, MSG_ZEROCOPY);
+					if (result >= 0) {
+						/* every succesful zero-copy send consumes one completion ID */
+						mZeroCopyPending.push_back(ZeroCopySend(mZeroCopyNextID, inOwner));
+						mZeroCopyNextID++;
+						return result;
+					}
+					if (errno != ENOBUFS)
+						return result;
+				}
+#endif
+				return send(mSocket, inData, inLen, 0);
+			}
+
+			/* Reads zero-copy completions from the socket error queue and releases finished buffers - returns the number of sends still pending */
+			size_t PollZeroCopyCompletions()
+			{
+				return ReadZeroCopyCompletions(mSocket, mZeroCopyPending);
+			}
+
+			/*
+			 * Polls the sockets that were closed while the kernel still had zero-copy sends from them in flight - a
+			 * socket is released, along with its buffers, once every send has completed. Returns the number of
+			 * closed sockets still waiting on the kernel
+			 */
+			static size_t PollLingeringZeroCopySends()
+			{
+#if CROSS_SOCK_ZEROCOPY
+				std::lock_guard<std::mutex> lock(GetLingeringMutex());
+				std::vector<ZeroCopyLinger>& lingering = GetLingering();
+				size_t l = 0;
+				while (l < lingering.size()) {
+					if (ReadZeroCopyCompletions(lingering[l].socket, lingering[l].pending) == 0) {
+						close(lingering[l].socket);
+						lingering[l] = std::move(lingering.back());
+						lingering.pop_back();
+					}
+					else {
+						l++;
+					}
+				}
+				return lingering.size();
+#else
+				return 0;
+#endif
+			}
+
+			/* Returns the number of zero-copy sends the kernel has yet to complete */
+			size_t GetPendingZeroCopySends() const
+			{
+				return mZeroCopyPending.size();
+			}
+
+			/* Returns the number of received bytes waiting to be read, or a negative number on failure */
+			int GetBytesAvailable() const
+			{
+#if _WIN32
+				u_long bytesAvailable = 0;
+				if (ioctlsocket(mSocket, FIONREAD, &bytesAvailable) != 0)
+					return -1;
+#else
+				int bytesAvailable = 0;
+				if (ioctl(mSocket, FIONREAD, &bytesAvailable) != 0)
+					return -1;
+#endif
+				return (int)bytesAvailable;
+			}
+
 			/* Sets this socket to blocking or non-blocking */
 			int SetNonBlockingMode(bool inShouldBeNonBlocking)
 			{
@@ -399,6 +1154,81 @@
 				return result;
 			}
 
+			/* Set a raw socket option - returns SUCCESS if succesful */
+			template <class T>
+			int SetOption(int inLevel, int inName, const T& inValue)
+			{
+				return CrossSockOptions::Set<T>(mSocket, inLevel, inName, inValue);
+			}
+
+			/* Get a raw socket option - returns SUCCESS if succesful */
+			template <class T>
+			int GetOption(int inLevel, int inName, T& outValue) const
+			{
+				return CrossSockOptions::Get<T>(mSocket, inLevel, inName, outValue);
+			}
+
+			/* Set the size of the kernel send buffer in bytes */
+			int SetSendBufferSize(int inBytes)
+			{
+				return CrossSockOptions::SetSendBufferSize(mSocket, inBytes);
+			}
+
+			/* Set the size of the kernel receive buffer in bytes */
+			int SetReceiveBufferSize(int inBytes)
+			{
+				return CrossSockOptions::SetReceiveBufferSize(mSocket, inBytes);
+			}
+
+			/* Set the IP type of service byte (the IPv6 traffic class on IPv6 sockets) - the DSCP code point is the upper 6 bits */
+			int SetTypeOfService(int inTypeOfService)
+			{
+				return CrossSockOptions::SetTypeOfService(mSocket, inTypeOfService);
+			}
+
+			/* Returns the address family of this socket (AF_INET or AF_INET6), or AF_UNSPEC if it can't be found */
+			int GetFamily() const
+			{
+				return CrossSockOptions::GetFamily(mSocket);
+			}
+
+			/* Set the priority of this socket's packets in the local queues - linux only */
+			int SetPriority(int inPriority)
+			{
+				return CrossSockOptions::SetPriority(mSocket, inPriority);
+			}
+
+			/* Disable (true) or enable (false) Nagle's algorithm */
+			int SetNoDelay(bool inShouldNotDelay)
+			{
+				return SetOption<int>(IPPROTO_TCP, TCP_NODELAY, inShouldNotDelay ? 1 : 0);
+			}
+
+			/* Acknowledge received data immediately - linux only, and the kernel may fall back to delayed acks */
+			int SetQuickAck(bool inShouldQuickAck)
+			{
+#ifdef TCP_QUICKACK
+				return SetOption<int>(IPPROTO_TCP, TCP_QUICKACK, inShouldQuickAck ? 1 : 0);
+#else
+				return SOCKET_ERROR;
+#endif
+			}
+
+			/* Apply each set option of a socket profile - returns SUCCESS if every supported option was applied */
+			int ApplyProfile(const CrossSockProfile& inProfile)
+			{
+				int result = CrossSockError::SUCCESS;
+				if (inProfile.noDelay >= 0 && SetNoDelay(inProfile.noDelay != 0) != 0)
+					result = CrossSockError::INVALID;
+#ifdef TCP_QUICKACK
+				if (inProfile.quickAck >= 0 && SetQuickAck(inProfile.quickAck != 0) != 0)
+					result = CrossSockError::INVALID;
+#endif
+				if (CrossSockOptions::ApplyProfile(mSocket, inProfile) != 0)
+					result = CrossSockError::INVALID;
+				return result;
+			}
+
 			/* Gets the local address associated with this socket */
 			CrossSockAddress GetLocalAddress() const
 			{
@@ -416,20 +1246,110 @@
 				getpeername(mSocket, &addr.mSockAddr, &length);
 				return addr;
 			}
-			/* Close this socket, terminating the connection on both sides */
+			/*
+			 * Close this socket, terminating the connection on both sides. If the kernel may still be sending from
+			 * zero-copy buffers, the socket is shut down and handed to PollLingeringZeroCopySends instead, which keeps
+			 * the buffers alive and closes it once the kernel is done with them
+			 */
 			int Close()
 			{
+				if (mSocket == INVALID_SOCKET)
+					return NO_ERROR;
+				SOCKET socket = mSocket;
+				mSocket = INVALID_SOCKET;
 #if _WIN32
-				return closesocket(mSocket);
+				return closesocket(socket);
 #else
-				return close(mSocket);
+#if CROSS_SOCK_ZEROCOPY
+				if (!mZeroCopyPending.empty() && ReadZeroCopyCompletions(socket, mZeroCopyPending) > 0) {
+					int result = shutdown(socket, SHUT_RDWR);
+					std::lock_guard<std::mutex> lock(GetLingeringMutex());
+					GetLingering().push_back(ZeroCopyLinger(socket, std::move(mZeroCopyPending)));
+					mZeroCopyPending.clear();
+					return result;
+				}
+#endif
+				return close(socket);
 #endif
 			}
 
 		private:
 			friend class CrossSockUtil;
-			TCPSocket(SOCKET inSocket) : mSocket(inSocket) {}
+			TCPSocket(SOCKET inSocket) : mSocket(inSocket), mZeroCopyEnabled(false), mReceiveTimestamps(false), mZeroCopyNextID(0) {}
+
+			/* A zero-copy send that the kernel may still be reading from */
+			struct ZeroCopySend
+			{
+				uint32_t id;
+				std::shared_ptr<const void> owner;
+
+				ZeroCopySend(uint32_t inID, const std::shared_ptr<const void>& inOwner) : id(inID), owner(inOwner) {}
+			};
+
+			/* A closed socket whose zero-copy sends haven't all completed */
+			struct ZeroCopyLinger
+			{
+				SOCKET socket;
+				std::deque<ZeroCopySend> pending;
+
+				ZeroCopyLinger(SOCKET inSocket, std::deque<ZeroCopySend>&& inPending) : socket(inSocket), pending(std::move(inPending)) {}
+			};
+
+			/* Reads zero-copy completions from a socket's error queue and releases finished sends - returns the number still pending */
+			static size_t ReadZeroCopyCompletions(SOCKET inSocket, std::deque<ZeroCopySend>& ioPending)
+			{
+#if CROSS_SOCK_ZEROCOPY
+				while (!ioPending.empty()) {
+					char control[128];
+					msghdr msg;
+					memset(&msg, 0, sizeof(msg));
+					msg.msg_control = control;
+					msg.msg_controllen = sizeof(control);
+					if (recvmsg(inSocket, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+						break;
+
+					for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+						if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+							(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+							continue;
+						sock_extended_err* err = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cmsg));
+						if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+							continue;
+
+						/* the kernel is done with every send in the inclusive range [ee_info, ee_data] */
+						uint32_t rangeStart = err->ee_info;
+						uint32_t rangeLength = err->ee_data - err->ee_info;
+						auto it = ioPending.begin();
+						while (it != ioPending.end()) {
+							if (it->id - rangeStart <= rangeLength)
+								it = ioPending.erase(it);
+							else
+								it++;
+						}
+					}
+				}
+#endif
+				return ioPending.size();
+			}
+
+			/* the lingering list is never destroyed, so sockets can still be closed during static destruction */
+			static std::vector<ZeroCopyLinger>& GetLingering()
+			{
+				static std::vector<ZeroCopyLinger>* lingering = new std::vector<ZeroCopyLinger>();
+				return *lingering;
+			}
+
+			static std::mutex& GetLingeringMutex()
+			{
+				static std::mutex* lingeringMutex = new std::mutex();
+				return *lingeringMutex;
+			}
+
 			SOCKET		mSocket;
+			bool		mZeroCopyEnabled;
+			bool		mReceiveTimestamps;
+			uint32_t	mZeroCopyNextID;
+			std::deque<ZeroCopySend> mZeroCopyPending;
 		};
 
 		typedef std::shared_ptr<CrossSock::TCPSocket> TCPSocketPtr;
@@ -28,9 +28,47 @@
 	#include <unistd.h> // for usleep
 #endif
 
+#ifdef __linux__
+	#include <sys/mman.h>    // for mmap
+	#include <sys/syscall.h> // for memfd_create
+	#include <unistd.h>
+#endif
+
 #include <string>
 #include <vector>
+#include <memory>
 #include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+
+/* Mirrored ring buffers map the same memory twice in a row (linux only) */
+#if defined(__linux__) && defined(SYS_memfd_create)
+	#define CROSS_SOCK_MIRRORED_RING 1
+#else
+	#define CROSS_SOCK_MIRRORED_RING 0
+#endif
+
+/* Compile-time endianness where the compiler reports it - otherwise it is checked at runtime */
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	#define CROSS_SOCK_LITTLE_ENDIAN 1
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	#define CROSS_SOCK_LITTLE_ENDIAN 0
+#endif
+
+/* CRC32C instructions - SSE4.2 is detected at runtime on x86, and ARM needs the CRC extension at compile time */
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#include <intrin.h>
+	#include <nmmintrin.h>
+	#define CROSS_SOCK_CRC32C_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#include <nmmintrin.h>
+	#define CROSS_SOCK_CRC32C_X86 1
+#elif defined(__ARM_FEATURE_CRC32)
+	#include <arm_acle.h>
+	#define CROSS_SOCK_CRC32C_ARM 1
+#endif
 
 namespace CrossSock {
 
@@ -79,7 +117,25 @@ namespace CrossSock {
 		INVALID_DATA_ID = -6,
 
 		/* The packet's payload size is greater than the maximum */
-		INVALID_PAYLOAD_SIZE = -7
+		INVALID_PAYLOAD_SIZE = -7,
+
+		/* The packet was dropped as it exceeded its bandwidth budget */
+		BANDWIDTH_EXCEEDED = -8
+	};
+
+	enum CrossChecksumType
+	{
+		/* Sum of the packet's bytes - cheap to compute but misses reordered bytes */
+		CHECKSUM_SUM = 0,
+
+		/* CRC32C (Castagnoli) - computed with CRC32 instructions where the CPU has them */
+		CHECKSUM_CRC32C = 1,
+
+		/* 32 bit xxHash - fast on every CPU */
+		CHECKSUM_XXHASH32 = 2,
+
+		/* Packets are finalized without a checksum */
+		CHECKSUM_NONE = 3
 	};
 
 	enum StaticDataID
@@ -109,8 +165,14 @@ namespace CrossSock {
 		/* Aliveness test packet */
 		ALIVENESS_TEST = 6,
 
+		/* Both Directions: Several packets packed into one datagram that share its sender ID */
+		AGGREGATE_PACK = 7,
+
+		/* Both Directions: A piece of a message too large for a single packet (see CrossFragmenter) */
+		FRAGMENT_PACK = 8,
+
 		/* Starting data ID of the custom data list */
-		CUSTOM_DATA_START = 7
+		CUSTOM_DATA_START = 9
 	};
 
 	/* Simple single event delegation */
@@ -138,6 +200,493 @@ namespace CrossSock {
 		std::chrono::high_resolution_clock::time_point start;
 	};
 
+	/*
+	 * Token bucket rate limiter - tokens (usually bytes) are refilled at a fixed
+	 * rate up to a burst size. The bucket is refilled from a time (in ms) given by
+	 * the caller, so that a clock cached once per update step can be reused and
+	 * the bucket costs almost nothing on the hot path.
+	 */
+	class CrossTokenBucket {
+	public:
+		CrossTokenBucket()
+		{
+			SetRate(0.0, 0.0, 0.0);
+		}
+
+		CrossTokenBucket(double inTokensPerSecond, double inBurstTokens, double inNow)
+		{
+			SetRate(inTokensPerSecond, inBurstTokens, inNow);
+		}
+
+		/* Sets the refill rate and burst size, and fills the bucket - a rate of 0 disables the limit */
+		void SetRate(double inTokensPerSecond, double inBurstTokens, double inNow)
+		{
+			tokensPerMS = inTokensPerSecond / 1000.0;
+			burstTokens = inBurstTokens;
+			tokens = inBurstTokens;
+			lastRefill = inNow;
+		}
+
+		/* Returns true if this bucket limits its rate - false otherwise */
+		bool IsLimited() const
+		{
+			return tokensPerMS > 0.0;
+		}
+
+		/* Refills this bucket up to the given time in ms */
+		void Refill(double inNow)
+		{
+			if (inNow > lastRefill) {
+				tokens += (inNow - lastRefill) * tokensPerMS;
+				if (tokens > burstTokens)
+					tokens = burstTokens;
+				lastRefill = inNow;
+			}
+		}
+
+		/* Returns true if the given amount of tokens is available at the given time - false otherwise */
+		bool CanConsume(double inAmount, double inNow)
+		{
+			if (!IsLimited())
+				return true;
+			Refill(inNow);
+			return tokens >= inAmount;
+		}
+
+		/* Removes the given amount of tokens from this bucket */
+		void Consume(double inAmount)
+		{
+			if (IsLimited())
+				tokens -= inAmount;
+		}
+
+		/* Gets the tokens currently available */
+		double GetTokens() const
+		{
+			return tokens;
+		}
+
+	private:
+		double tokensPerMS;
+		double burstTokens;
+		double tokens;
+		double lastRefill;
+	};
+
+	/*
+	 * A receive buffer that never moves unread bytes to make room. Where possible, the
+	 * buffer's memory is mapped twice in a row, so that data that wraps past the end
+	 * is still contiguous and both the readable and writable regions are always a
+	 * single span. Elsewhere it falls back to a flat buffer that only compacts when
+	 * the space left at its end gets small.
+	 */
+	class CrossRingBuffer {
+	public:
+		CrossRingBuffer(size_t inCapacity = CROSS_SOCK_BUFFER_SIZE)
+		{
+			data = nullptr;
+			capacity = 0;
+			readPos = 0;
+			size = 0;
+			isMirrored = false;
+#if CROSS_SOCK_MIRRORED_RING
+			/* each mirrored buffer costs two mappings - past the budget, buffers are flat */
+			if (GetNumMirrored().fetch_add(1) < GetMaxMirrored()) {
+				size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+				size_t mirroredCapacity = ((inCapacity + pageSize - 1) / pageSize) * pageSize;
+				int fd = (int)syscall(SYS_memfd_create, "CrossRingBuffer", 0);
+				if (fd >= 0) {
+					if (ftruncate(fd, mirroredCapacity) == 0) {
+						void* region = mmap(nullptr, mirroredCapacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+						if (region != MAP_FAILED) {
+							char* base = static_cast<char*>(region);
+							if (mmap(base, mirroredCapacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+								&& mmap(base + mirroredCapacity, mirroredCapacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED) {
+								data = base;
+								capacity = mirroredCapacity;
+								isMirrored = true;
+							}
+							else {
+								munmap(region, mirroredCapacity * 2);
+							}
+						}
+					}
+					close(fd);
+				}
+			}
+			if (!isMirrored)
+				GetNumMirrored().fetch_sub(1);
+#endif
+			if (!isMirrored) {
+				data = new char[inCapacity];
+				capacity = inCapacity;
+			}
+		}
+
+		~CrossRingBuffer()
+		{
+#if CROSS_SOCK_MIRRORED_RING
+			if (isMirrored) {
+				munmap(data, capacity * 2);
+				GetNumMirrored().fetch_sub(1);
+				return;
+			}
+#endif
+			delete[] data;
+		}
+
+		/* Gets the start of the unread data */
+		char* GetReadPtr() const
+		{
+			return data + readPos;
+		}
+
+		/* Gets the number of unread bytes */
+		size_t GetSize() const
+		{
+			return size;
+		}
+
+		/* Marks bytes at the start of the unread data as read */
+		void Consume(size_t inLength)
+		{
+			if (inLength >= size) {
+				readPos = 0;
+				size = 0;
+				return;
+			}
+			readPos += inLength;
+			size -= inLength;
+			if (isMirrored && readPos >= capacity)
+				readPos -= capacity;
+		}
+
+		/* Gets the start of the writable space - the flat fallback compacts here if its remaining space is small */
+		char* GetWritePtr()
+		{
+			if (isMirrored) {
+				size_t writePos = readPos + size;
+				return data + (writePos >= capacity ? writePos - capacity : writePos);
+			}
+			if (readPos > 0 && capacity - readPos - size < capacity / 4) {
+				memmove(data, data + readPos, size);
+				readPos = 0;
+			}
+			return data + readPos + size;
+		}
+
+		/* Gets the number of bytes that can be written at GetWritePtr */
+		size_t GetWriteSpace() const
+		{
+			return isMirrored ? capacity - size : capacity - readPos - size;
+		}
+
+		/* Marks bytes written at GetWritePtr as unread data */
+		void Commit(size_t inLength)
+		{
+			size += inLength;
+		}
+
+		/* Discards all unread data */
+		void Clear()
+		{
+			readPos = 0;
+			size = 0;
+		}
+
+		/* Gets the total number of bytes this buffer can hold */
+		size_t GetCapacity() const
+		{
+			return capacity;
+		}
+
+		/* Returns true if this buffer's memory is mirrored - false if it uses the flat fallback */
+		bool IsMirrored() const
+		{
+			return isMirrored;
+		}
+
+		/*
+		 * Sets how many buffers may be mirrored at once - each one takes two memory mappings (and a memfd while
+		 * it is set up), so this keeps many connections well under the system's mapping limit (vm.max_map_count).
+		 * Buffers created past the budget use the flat fallback
+		 */
+		static void SetMaxMirroredBuffers(size_t inMaxBuffers)
+		{
+			GetMaxMirrored() = inMaxBuffers;
+		}
+
+		/* Gets the number of mirrored buffers in use */
+		static size_t GetNumMirroredBuffers()
+		{
+			return GetNumMirrored();
+		}
+
+		/* The default budget of mirrored buffers - 8192 mappings out of the default limit of 65530 */
+		static const size_t DEFAULT_MAX_MIRRORED_BUFFERS = 4096;
+
+	private:
+		CrossRingBuffer(const CrossRingBuffer&);
+		CrossRingBuffer& operator=(const CrossRingBuffer&);
+
+		static std::atomic<size_t>& GetNumMirrored()
+		{
+			static std::atomic<size_t> numMirrored(0);
+			return numMirrored;
+		}
+
+		static std::atomic<size_t>& GetMaxMirrored()
+		{
+			static std::atomic<size_t> maxMirrored(DEFAULT_MAX_MIRRORED_BUFFERS);
+			return maxMirrored;
+		}
+
+		char* data;
+		size_t capacity;
+		size_t readPos;
+		size_t size;
+		bool isMirrored;
+	};
+
+	typedef std::unique_ptr<CrossRingBuffer> CrossRingBufferPtr;
+
+	/*
+	 * A pool of ring buffers in a few size classes - buffers are taken only while there is
+	 * unread data to hold and returned once drained, so idle connections cost nothing. Up
+	 * to a fixed number of free buffers per size class are kept for reuse, so mirrored
+	 * buffers are mapped once rather than on every use.
+	 */
+	class CrossRingBufferPool {
+	public:
+		CrossRingBufferPool(size_t inMaxFreePerClass = 64)
+		{
+			maxFreePerClass = inMaxFreePerClass;
+		}
+
+		/* Takes a buffer of the smallest size class that holds at least the given number of bytes */
+		CrossRingBufferPtr Acquire(size_t inMinCapacity)
+		{
+			int sizeClass = GetSizeClass(inMinCapacity);
+			if (!freeBuffers[sizeClass].empty()) {
+				CrossRingBufferPtr buffer = std::move(freeBuffers[sizeClass].back());
+				freeBuffers[sizeClass].pop_back();
+				return buffer;
+			}
+			return CrossRingBufferPtr(new CrossRingBuffer(GetSizeClassBytes(sizeClass)));
+		}
+
+		/* Returns a buffer to the pool - its unread data is discarded */
+		void Release(CrossRingBufferPtr& inBuffer)
+		{
+			if (!inBuffer)
+				return;
+			int sizeClass = GetSizeClass(inBuffer->GetCapacity());
+			inBuffer->Clear();
+			if (freeBuffers[sizeClass].size() < maxFreePerClass)
+				freeBuffers[sizeClass].push_back(std::move(inBuffer));
+			inBuffer.reset();
+		}
+
+		/* Gets the index of the smallest size class that holds the given number of bytes */
+		static int GetSizeClass(size_t inBytes)
+		{
+			for (int c = 0; c < NUM_SIZE_CLASSES - 1; c++) {
+				if (inBytes <= GetSizeClassBytes(c))
+					return c;
+			}
+			return NUM_SIZE_CLASSES - 1;
+		}
+
+		/* Gets the buffer size of a size class - 4 KB, 16 KB, or 64 KB */
+		static size_t GetSizeClassBytes(int inSizeClass)
+		{
+			static const size_t sizeClasses[NUM_SIZE_CLASSES] = { 4096, 16384, CROSS_SOCK_BUFFER_SIZE };
+			return sizeClasses[inSizeClass];
+		}
+
+		/* Gets the number of free buffers held by the pool */
+		size_t GetNumFreeBuffers() const
+		{
+			size_t numFree = 0;
+			for (int c = 0; c < NUM_SIZE_CLASSES; c++)
+				numFree += freeBuffers[c].size();
+			return numFree;
+		}
+
+		static const int NUM_SIZE_CLASSES = 3;
+
+	private:
+		std::vector<CrossRingBufferPtr> freeBuffers[NUM_SIZE_CLASSES];
+		size_t maxFreePerClass;
+	};
+
+	/*
+	 * Free lists of memory blocks of a single size - each thread takes and returns blocks through
+	 * its own list without locking. A thread whose list grows too long hands a batch over to the
+	 * shared overflow list, which threads that run dry take batches from, so blocks freed on one
+	 * thread (like packets handed to workers) flow back to the threads allocating them.
+	 */
+	template <size_t BlockSize>
+	class CrossBlockPool {
+	public:
+
+		/* Takes a block from the pool - allocates a new one if the pool is empty */
+		static void* Allocate()
+		{
+			LocalList* local = GetLocal();
+			if (local) {
+				if (local->blocks.empty())
+					TakeOverflow(local->blocks);
+				if (!local->blocks.empty()) {
+					void* block = local->blocks.back();
+					local->blocks.pop_back();
+					return block;
+				}
+			}
+			return ::operator new(BlockSize);
+		}
+
+		/* Returns a block to the pool */
+		static void Free(void* inBlock)
+		{
+			if (!inBlock)
+				return;
+			LocalList* local = GetLocal();
+			if (!local) {
+				::operator delete(inBlock);
+				return;
+			}
+			local->blocks.push_back(inBlock);
+			if (local->blocks.size() > MAX_LOCAL_BLOCKS)
+				GiveOverflow(local->blocks, TRANSFER_BLOCKS);
+		}
+
+		/* Returns the number of free blocks held by the calling thread */
+		static size_t GetNumLocalBlocks()
+		{
+			LocalList* local = GetLocal();
+			return local ? local->blocks.size() : 0;
+		}
+
+		/* Returns the number of free blocks in the shared overflow list */
+		static size_t GetNumOverflowBlocks()
+		{
+			std::lock_guard<std::mutex> lock(GetOverflowMutex());
+			return GetOverflow().size();
+		}
+
+		/* The number of free blocks a thread keeps before handing some to the overflow list */
+		static const size_t MAX_LOCAL_BLOCKS = 256;
+
+		/* The number of blocks moved between a thread and the overflow list at once */
+		static const size_t TRANSFER_BLOCKS = 64;
+
+		/* The number of free blocks the overflow list keeps before freeing the rest */
+		static const size_t MAX_OVERFLOW_BLOCKS = 4096;
+
+	private:
+
+		/* A thread's free list - its blocks go to the overflow list when the thread exits */
+		struct LocalList {
+			std::vector<void*> blocks;
+
+			~LocalList()
+			{
+				GiveOverflow(blocks, blocks.size());
+				IsLocalDestroyed() = true;
+			}
+		};
+
+		/* Returns the calling thread's free list, or nullptr once the thread is shutting down */
+		static LocalList* GetLocal()
+		{
+			if (IsLocalDestroyed())
+				return nullptr;
+			static thread_local LocalList local;
+			return &local;
+		}
+
+		static bool& IsLocalDestroyed()
+		{
+			static thread_local bool isDestroyed = false;
+			return isDestroyed;
+		}
+
+		/* the overflow list is never destroyed, so blocks can be freed during static destruction */
+		static std::vector<void*>& GetOverflow()
+		{
+			static std::vector<void*>* overflow = new std::vector<void*>();
+			return *overflow;
+		}
+
+		static std::mutex& GetOverflowMutex()
+		{
+			static std::mutex* overflowMutex = new std::mutex();
+			return *overflowMutex;
+		}
+
+		static void TakeOverflow(std::vector<void*>& outBlocks)
+		{
+			std::lock_guard<std::mutex> lock(GetOverflowMutex());
+			std::vector<void*>& overflow = GetOverflow();
+			size_t count = overflow.size() < TRANSFER_BLOCKS ? overflow.size() : TRANSFER_BLOCKS;
+			outBlocks.insert(outBlocks.end(), overflow.end() - count, overflow.end());
+			overflow.resize(overflow.size() - count);
+		}
+
+		static void GiveOverflow(std::vector<void*>& inBlocks, size_t inCount)
+		{
+			std::lock_guard<std::mutex> lock(GetOverflowMutex());
+			std::vector<void*>& overflow = GetOverflow();
+			for (size_t b = inBlocks.size() - inCount; b < inBlocks.size(); b++) {
+				if (overflow.size() < MAX_OVERFLOW_BLOCKS)
+					overflow.push_back(inBlocks[b]);
+				else
+					::operator delete(inBlocks[b]);
+			}
+			inBlocks.resize(inBlocks.size() - inCount);
+		}
+	};
+
+	/* Standard allocator that takes single objects from a CrossBlockPool - for allocate_shared and containers of nodes */
+	template <class T>
+	class CrossPoolAllocator {
+	public:
+		typedef T value_type;
+
+		CrossPoolAllocator() {}
+
+		template <class U>
+		CrossPoolAllocator(const CrossPoolAllocator<U>&) {}
+
+		T* allocate(size_t inCount)
+		{
+			if (inCount == 1)
+				return static_cast<T*>(CrossBlockPool<sizeof(T)>::Allocate());
+			return static_cast<T*>(::operator new(inCount * sizeof(T)));
+		}
+
+		void deallocate(T* inObjects, size_t inCount)
+		{
+			if (inCount == 1)
+				CrossBlockPool<sizeof(T)>::Free(inObjects);
+			else
+				::operator delete(inObjects);
+		}
+
+		template <class U>
+		bool operator==(const CrossPoolAllocator<U>&) const
+		{
+			return true;
+		}
+
+		template <class U>
+		bool operator!=(const CrossPoolAllocator<U>&) const
+		{
+			return false;
+		}
+	};
+
 	/* 
 	 * Cross-platform delegation - this implementation is ugly but is capable of surviving
 	 * garbage collection (i.e. useable in Unreal Engine 4). It isn't recommended to use
@@ -400,10 +949,130 @@ namespace CrossSock {
 		/* Returns true if on a little endian system; false otherwise */
 		static bool IsLittleEndian()
 		{
+#ifdef CROSS_SOCK_LITTLE_ENDIAN
+			return CROSS_SOCK_LITTLE_ENDIAN;
+#else
 			int n = 1;
 			if (*(char *)&n == 1)
 				return true;
 			return false;
+#endif
+		}
+
+		/* Utility function that loads a little endian value from unaligned data in the native endianness */
+		template <class T>
+		static T LoadLittleEndian(const char* inData)
+		{
+			T outValue;
+			memcpy(&outValue, inData, sizeof(T));
+			if (!IsLittleEndian())
+				SwapEndian((char*)&outValue, 0, sizeof(T));
+			return outValue;
+		}
+
+		/* The maximum size of a varint in bytes */
+		static const int MAX_VARINT_BYTES = 10;
+
+		/* Utility function that writes a value as a varint (LEB128 - 7 bits per byte, low bits first) - returns the number of bytes written */
+		static int EncodeVarint(uint64_t inValue, unsigned char* outData)
+		{
+			int length = 0;
+			while (inValue >= 0x80) {
+				outData[length++] = (unsigned char)(inValue | 0x80);
+				inValue >>= 7;
+			}
+			outData[length++] = (unsigned char)inValue;
+			return length;
+		}
+
+		/* Utility function that returns the number of bytes a value takes as a varint */
+		static int GetVarintLength(uint64_t inValue)
+		{
+			return (63 - CountLeadingZeros64(inValue | 1)) / 7 + 1;
+		}
+
+		/*
+		 * Utility function that reads a varint - returns the number of bytes read, or 0 if the data ends
+		 * before the varint does or it is longer than MAX_VARINT_BYTES. With 8 bytes or more available, varints
+		 * of up to 8 bytes are decoded from a single load without a branch per byte.
+		 */
+		static int DecodeVarint(const unsigned char* inData, size_t inAvailable, uint64_t& outValue)
+		{
+			if (inAvailable >= 8) {
+				uint64_t word = LoadLittleEndian<uint64_t>((const char*)inData);
+				uint64_t stopBits = ~word & 0x8080808080808080ULL;
+				if (stopBits != 0) {
+
+					/* keep the varint's bytes, drop their continuation bits, and squeeze the 7 bit groups together */
+					int length = CountTrailingZeros64(stopBits) / 8 + 1;
+					uint64_t value = (length == 8 ? word : word & ((1ULL << (8 * length)) - 1)) & 0x7F7F7F7F7F7F7F7FULL;
+					value = ((value & 0x7F007F007F007F00ULL) >> 1) | (value & 0x007F007F007F007FULL);
+					value = ((value & 0x3FFF00003FFF0000ULL) >> 2) | (value & 0x00003FFF00003FFFULL);
+					value = ((value & 0x0FFFFFFF00000000ULL) >> 4) | (value & 0x000000000FFFFFFFULL);
+					outValue = value;
+					return length;
+				}
+			}
+
+			uint64_t value = 0;
+			for (int b = 0; b < MAX_VARINT_BYTES && (size_t)b < inAvailable; b++) {
+				value |= (uint64_t)(inData[b] & 0x7F) << (7 * b);
+				if ((inData[b] & 0x80) == 0) {
+					outValue = value;
+					return b + 1;
+				}
+			}
+			return 0;
+		}
+
+		/* Utility function that maps signed values to unsigned so that small magnitudes stay small (0, -1, 1, -2 ... become 0, 1, 2, 3 ...) */
+		static uint64_t ZigZagEncode(int64_t inValue)
+		{
+			return ((uint64_t)inValue << 1) ^ (uint64_t)(inValue >> 63);
+		}
+
+		/* Utility function that reverses ZigZagEncode */
+		static int64_t ZigZagDecode(uint64_t inValue)
+		{
+			return (int64_t)(inValue >> 1) ^ -(int64_t)(inValue & 1);
+		}
+
+		/* Utility function that returns the number of trailing zero bits of a non-zero value */
+		static int CountTrailingZeros64(uint64_t inValue)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return __builtin_ctzll(inValue);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index;
+			_BitScanForward64(&index, inValue);
+			return (int)index;
+#else
+			int count = 0;
+			while ((inValue & 1) == 0) {
+				inValue >>= 1;
+				count++;
+			}
+			return count;
+#endif
+		}
+
+		/* Utility function that returns the number of leading zero bits of a non-zero value */
+		static int CountLeadingZeros64(uint64_t inValue)
+		{
+#if defined(__GNUC__) || defined(__clang__)
+			return __builtin_clzll(inValue);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			unsigned long index;
+			_BitScanReverse64(&index, inValue);
+			return 63 - (int)index;
+#else
+			int count = 0;
+			while ((inValue & (1ULL << 63)) == 0) {
+				inValue <<= 1;
+				count++;
+			}
+			return count;
+#endif
 		}
 
 		/* Utility function that flips packed data - useful when the endianness is opposite on a given system */
@@ -485,6 +1154,203 @@ namespace CrossSock {
 		    usleep(milliseconds * 1000);
 #endif
 		}
+
+		/* Returns the wall clock time in nanoseconds since the epoch - the clock kernel receive timestamps are taken from */
+		static int64_t GetSystemTimeNS()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		}
+	};
+
+	/* Checksum algorithms used to validate packets - see CrossChecksumType */
+	class CrossChecksum
+	{
+	public:
+
+		/* Continues a CRC32C over the given data - start with a CRC of 0 */
+		static uint32_t Crc32c(uint32_t inCrc, const void* inData, size_t inLength)
+		{
+#if defined(CROSS_SOCK_CRC32C_X86) || defined(CROSS_SOCK_CRC32C_ARM)
+			if (HasHardwareCrc32c())
+				return Crc32cHardware(inCrc, inData, inLength);
+#endif
+			return Crc32cSoftware(inCrc, inData, inLength);
+		}
+
+		/* Continues a CRC32C over the given data without CRC32 instructions (slicing-by-8) */
+		static uint32_t Crc32cSoftware(uint32_t inCrc, const void* inData, size_t inLength)
+		{
+			const uint32_t (*table)[256] = GetCrc32cTable();
+			const unsigned char* data = static_cast<const unsigned char*>(inData);
+			uint32_t crc = ~inCrc;
+			while (inLength >= 8) {
+				uint32_t low = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+				crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24]
+					^ table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+				data += 8;
+				inLength -= 8;
+			}
+			while (inLength > 0) {
+				crc = table[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+				data++;
+				inLength--;
+			}
+			return ~crc;
+		}
+
+		/* Returns true if CRC32C is computed with CRC32 instructions */
+		static bool HasHardwareCrc32c()
+		{
+#if defined(CROSS_SOCK_CRC32C_X86) && defined(_MSC_VER)
+			static const bool hasSSE42 = []() {
+				int info[4];
+				__cpuid(info, 1);
+				return (info[2] & (1 << 20)) != 0;
+			}();
+			return hasSSE42;
+#elif defined(CROSS_SOCK_CRC32C_X86)
+			static const bool hasSSE42 = __builtin_cpu_supports("sse4.2") != 0;
+			return hasSSE42;
+#elif defined(CROSS_SOCK_CRC32C_ARM)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		/* Computes the 32 bit xxHash (XXH32) of the given data */
+		static uint32_t XXHash32(const void* inData, size_t inLength, uint32_t inSeed = 0)
+		{
+			const unsigned char* data = static_cast<const unsigned char*>(inData);
+			const unsigned char* end = data + inLength;
+			uint32_t hash;
+			if (inLength >= 16) {
+				uint32_t v1 = inSeed + PRIME32_1 + PRIME32_2;
+				uint32_t v2 = inSeed + PRIME32_2;
+				uint32_t v3 = inSeed;
+				uint32_t v4 = inSeed - PRIME32_1;
+				const unsigned char* limit = end - 16;
+				do {
+					v1 = XXHashRound(v1, Load32(data));
+					v2 = XXHashRound(v2, Load32(data + 4));
+					v3 = XXHashRound(v3, Load32(data + 8));
+					v4 = XXHashRound(v4, Load32(data + 12));
+					data += 16;
+				} while (data <= limit);
+				hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+			}
+			else {
+				hash = inSeed + PRIME32_5;
+			}
+			hash += (uint32_t)inLength;
+			while (data + 4 <= end) {
+				hash = RotateLeft(hash + Load32(data) * PRIME32_3, 17) * PRIME32_4;
+				data += 4;
+			}
+			while (data < end) {
+				hash = RotateLeft(hash + (*data) * PRIME32_5, 11) * PRIME32_1;
+				data++;
+			}
+			hash ^= hash >> 15;
+			hash *= PRIME32_2;
+			hash ^= hash >> 13;
+			hash *= PRIME32_3;
+			hash ^= hash >> 16;
+			return hash;
+		}
+
+	private:
+		static const uint32_t PRIME32_1 = 2654435761U;
+		static const uint32_t PRIME32_2 = 2246822519U;
+		static const uint32_t PRIME32_3 = 3266489917U;
+		static const uint32_t PRIME32_4 = 668265263U;
+		static const uint32_t PRIME32_5 = 374761393U;
+
+		/* Continues a CRC32C with CRC32 instructions - 8 bytes per instruction */
+#if defined(CROSS_SOCK_CRC32C_X86) && !defined(_MSC_VER)
+		__attribute__((target("sse4.2")))
+#endif
+#if defined(CROSS_SOCK_CRC32C_X86) || defined(CROSS_SOCK_CRC32C_ARM)
+		static uint32_t Crc32cHardware(uint32_t inCrc, const void* inData, size_t inLength)
+		{
+			const unsigned char* data = static_cast<const unsigned char*>(inData);
+			uint32_t crc = ~inCrc;
+#if defined(CROSS_SOCK_CRC32C_ARM)
+			while (inLength >= 8) {
+				uint64_t chunk;
+				memcpy(&chunk, data, sizeof(chunk));
+				crc = __crc32cd(crc, chunk);
+				data += 8;
+				inLength -= 8;
+			}
+			while (inLength > 0) {
+				crc = __crc32cb(crc, *data);
+				data++;
+				inLength--;
+			}
+#else
+#if defined(_M_X64) || defined(__x86_64__)
+			uint64_t crc64 = crc;
+			while (inLength >= 8) {
+				uint64_t chunk;
+				memcpy(&chunk, data, sizeof(chunk));
+				crc64 = _mm_crc32_u64(crc64, chunk);
+				data += 8;
+				inLength -= 8;
+			}
+			crc = (uint32_t)crc64;
+#endif
+			while (inLength >= 4) {
+				uint32_t chunk;
+				memcpy(&chunk, data, sizeof(chunk));
+				crc = _mm_crc32_u32(crc, chunk);
+				data += 4;
+				inLength -= 4;
+			}
+			while (inLength > 0) {
+				crc = _mm_crc32_u8(crc, *data);
+				data++;
+				inLength--;
+			}
+#endif
+			return ~crc;
+		}
+#endif
+
+		/* Gets the slicing-by-8 tables of the reflected CRC32C polynomial */
+		static const uint32_t (*GetCrc32cTable())[256]
+		{
+			static uint32_t table[8][256];
+			static std::once_flag isFilled;
+			std::call_once(isFilled, []() {
+				for (uint32_t n = 0; n < 256; n++) {
+					uint32_t crc = n;
+					for (int b = 0; b < 8; b++)
+						crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78U : crc >> 1;
+					table[0][n] = crc;
+				}
+				for (uint32_t n = 0; n < 256; n++) {
+					for (int t = 1; t < 8; t++)
+						table[t][n] = (table[t - 1][n] >> 8) ^ table[0][table[t - 1][n] & 0xFF];
+				}
+			});
+			return table;
+		}
+
+		static uint32_t RotateLeft(uint32_t inValue, int inBits)
+		{
+			return (inValue << inBits) | (inValue >> (32 - inBits));
+		}
+
+		static uint32_t Load32(const unsigned char* inData)
+		{
+			return (uint32_t)inData[0] | ((uint32_t)inData[1] << 8) | ((uint32_t)inData[2] << 16) | ((uint32_t)inData[3] << 24);
+		}
+
+		static uint32_t XXHashRound(uint32_t inAcc, uint32_t inInput)
+		{
+			return RotateLeft(inAcc + inInput * PRIME32_2, 13) * PRIME32_1;
+		}
 	};
 }
 
@@ -0,0 +1,85 @@
+/**********************************************************************************************************
+*  AUTHOR: Brandon Wilson  ********************************************************************************
+*  A type-safe cross-platform header-only lightweight socket library developed on top of berkely sockets  *
+**********************************************************************************************************/
+
+/*
+ * This file measures the cost of finalizing a full packet with each checksum algorithm (see
+ * CrossChecksumType), and of the CRC32C and xxHash routines on their own. Build it with
+ * optimizations and the CrossSock folder on the include path, for example:
+ *
+ *	g++ -std=c++11 -O2 -I../../CrossSock CrossSockChecksumBenchmark.cpp -o CrossSockChecksumBenchmark
+ *
+ * The number of iterations per measurement can be given as the first argument - raise it for steadier
+ * numbers on a busy machine.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "CrossPack.h"
+
+using namespace std;
+using namespace CrossSock;
+
+#define DEFAULT_NUM_ITERATIONS 200000
+
+/* Keeps the compiler from optimizing away the measured work */
+volatile uint32_t checksumSink;
+
+/* The number of times each checksum routine is run */
+int numIterations = DEFAULT_NUM_ITERATIONS;
+
+/* Runs a checksum routine numIterations times and prints its throughput over the given number of bytes */
+template <class Routine>
+void Measure(const char* inName, size_t inBytes, Routine inRoutine)
+{
+	CrossTimer timer;
+	for (int i = 0; i < numIterations; i++) {
+		checksumSink += inRoutine(i);
+	}
+	double seconds = timer.GetElapsedTime() / 1000.0;
+	printf("%-24s %6.2f GB/s %8.1f ns/packet\n", inName, (double)inBytes * numIterations / seconds / 1e9, seconds / numIterations * 1e9);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && atoi(argv[1]) > 0) {
+		numIterations = atoi(argv[1]);
+	}
+
+	/* fill a packet to its maximum payload with random bytes */
+	CrossPackData data[CrossPack::MAX_PAYLOAD_BYTES];
+	for (size_t b = 0; b < sizeof(data); b++) {
+		data[b] = (CrossPackData)rand();
+	}
+	CrossPack pack(StaticDataID::CUSTOM_DATA_START);
+	pack.AddDataToPayload(data, CrossPack::MAX_PAYLOAD_BYTES);
+	size_t payloadSize = pack.GetPayloadSize();
+
+	printf("Payload: %u bytes, %d iterations, hardware CRC32C: %s\n\n", (unsigned int)payloadSize, numIterations, CrossChecksum::HasHardwareCrc32c() ? "yes" : "no");
+
+	/* whole packets - the sender ID changes each time so that nothing can be cached */
+	const char* names[] = { "Finalize SUM", "Finalize CRC32C", "Finalize XXHASH32" };
+	for (int type = CrossChecksumType::CHECKSUM_SUM; type < CrossChecksumType::CHECKSUM_NONE; type++) {
+		Measure(names[type], payloadSize, [&](int i) {
+			pack.Finalize(true, true, (CrossClientID)i, (CrossChecksumType)type);
+			return (uint32_t)pack.GetChecksum();
+		});
+	}
+
+	/* the routines alone */
+	Measure("CRC32C", payloadSize, [&](int i) {
+		data[0] = (CrossPackData)i;
+		return CrossChecksum::Crc32c(0, data, payloadSize);
+	});
+	Measure("CRC32C software", payloadSize, [&](int i) {
+		data[0] = (CrossPackData)i;
+		return CrossChecksum::Crc32cSoftware(0, data, payloadSize);
+	});
+	Measure("XXHash32", payloadSize, [&](int i) {
+		data[0] = (CrossPackData)i;
+		return CrossChecksum::XXHash32(data, payloadSize);
+	});
+
+	return 0;
+}